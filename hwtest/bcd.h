@@ -0,0 +1,27 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file bcd.h
+ * Conversion between binary coded decimal and binary values
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#ifndef _BCD_H_
+#define _BCD_H_
+
+#include <stdint.h>
+
+static inline uint8_t bcd_to_dec(uint8_t x)
+{
+    return x - 6 * (x>>4);
+}
+
+static inline uint8_t dec_to_bcd(uint8_t x)
+{
+    return x + 6 * (x/10);
+}
+
+#endif
@@ -0,0 +1,27 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file bench_ref.h
+ * Reference cycle counts of the benchmark kernels
+ *
+ * Cycles per run of the pure cpu kernels of benchmark.c, built with the
+ * compiler and options of the Makefile at F_CPU. The counts do not depend
+ * on the board, so they are kept here and reviewed with the code change
+ * that moves them. 0 means not recorded yet and fails the kernel, so an
+ * unrecorded header never passes as a baseline. "make simbench" prints
+ * the lines below from a simavr run.
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#ifndef _BENCH_REF_H_
+#define _BENCH_REF_H_
+
+#define BENCH_REF_BCD_TO_DEC   0
+#define BENCH_REF_DEC_TO_BCD   0
+#define BENCH_REF_CRC_CCITT    0
+#define BENCH_REF_TOTIMESTAMP  0
+
+#endif
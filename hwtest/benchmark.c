@@ -0,0 +1,317 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file benchmark.c
+ * Cycle counting benchmark of the firmware kernels
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <util/crc16.h>
+
+#include "bcd.h"
+#include "clock.h"
+#include "i2creg.h"
+#include "rv8523.h"
+#include "rv8523_regs.h"
+#include "flash.h"
+#include "logstore.h"
+#include "spi_master.h"
+#include "benchmark.h"
+#include "bench_ref.h"
+
+#define BENCH_DATA_SIZE  64
+
+/** one kernel of the benchmark */
+typedef struct {
+    const char *name;     /**< name in program memory */
+    void (*run)(void);    /**< executes ops operations */
+    uint8_t ops;          /**< operations per run */
+    uint8_t bytes;        /**< bytes processed per run, 0 if not applicable */
+    bool io;              /**< bound by the bus or the log contents, reported only */
+    uint32_t ref;         /**< reference cycles per run, 0 fails until recorded */
+} bench_kernel_t;
+
+static uint8_t data[BENCH_DATA_SIZE];
+static volatile uint8_t sink8;
+static volatile uint16_t sink16;
+static volatile uint32_t sink32;
+
+
+/*
+ * kernels
+ */
+
+static void run_empty(void)
+{
+}
+
+static void run_bcd_to_dec(void)
+{
+    uint8_t i;
+    for(i=0; i<BENCH_DATA_SIZE; ++i)
+        sink8 = bcd_to_dec(data[i]);
+}
+
+static void run_dec_to_bcd(void)
+{
+    uint8_t i;
+    for(i=0; i<BENCH_DATA_SIZE; ++i)
+        sink8 = dec_to_bcd(bcd_to_dec(data[i]));
+}
+
+static void run_crc(void)
+{
+    uint16_t crc = 0xffff;
+    uint8_t i;
+    for(i=0; i<BENCH_DATA_SIZE; ++i)
+        crc = _crc_ccitt_update(crc, data[i]);
+    sink16 = crc;
+}
+
+static void run_timestamp(void)
+{
+    uint8_t i;
+    for(i=0; i<BENCH_DATA_SIZE; i+=8)
+        sink32 = rv8523_toTimestamp(21, 1 + (i & 0x07), 28, 23, 59, 59);
+}
+
+static void run_log_find(void)
+{
+    sink16 = log_find(LOG_RAW, sink32);
+}
+
+static void run_flash_read(void)
+{
+    flash_read(0, 0, data, BENCH_DATA_SIZE);
+}
+
+static void run_rtc_read(void)
+{
+    uint8_t y, mo, d, wd, h, mi, s;
+    rv8523_getDateTime24(&y, &mo, &d, &wd, &h, &mi, &s, false);
+    sink8 = s;
+}
+
+/* the RTC part of the wake-up ISR, the pin waits are left out */
+static void run_rtc_ack(void)
+{
+    rv8523_clearAlarmFlag();
+    rv8523_setAlarmMinute(false, 0, true);
+}
+
+static const char name_bcd_to_dec[] PROGMEM = "bcd_to_dec";
+static const char name_dec_to_bcd[] PROGMEM = "dec_to_bcd";
+static const char name_crc[] PROGMEM = "crc_ccitt";
+static const char name_timestamp[] PROGMEM = "toTimestamp";
+static const char name_log_find[] PROGMEM = "log_find";
+static const char name_flash_read[] PROGMEM = "flash_read";
+static const char name_rtc_read[] PROGMEM = "rtc_read";
+static const char name_rtc_ack[] PROGMEM = "rtc_ack";
+
+static const bench_kernel_t kernels[] PROGMEM = {
+    {name_bcd_to_dec, run_bcd_to_dec, BENCH_DATA_SIZE,   BENCH_DATA_SIZE, false, BENCH_REF_BCD_TO_DEC},
+    {name_dec_to_bcd, run_dec_to_bcd, BENCH_DATA_SIZE,   BENCH_DATA_SIZE, false, BENCH_REF_DEC_TO_BCD},
+    {name_crc,        run_crc,        1,                 BENCH_DATA_SIZE, false, BENCH_REF_CRC_CCITT},
+    {name_timestamp,  run_timestamp,  BENCH_DATA_SIZE/8, 0,               false, BENCH_REF_TOTIMESTAMP},
+    {name_log_find,   run_log_find,   1,                 0,               true,  0},
+    {name_flash_read, run_flash_read, 1,                 BENCH_DATA_SIZE, true,  0},
+    {name_rtc_read,   run_rtc_read,   1,                 7,               true,  0},
+    {name_rtc_ack,    run_rtc_ack,    1,                 0,               true,  0},
+};
+
+#define NUM_KERNELS (sizeof(kernels)/sizeof(kernels[0]))
+
+/* single operations of the hardware benchmark */
+static void run_i2c_probe(void)
+{
+    sink8 = i2c_probe(DEV_RV8523);
+}
+
+static void run_i2c_read(void)
+{
+    i2c_read_regs(DEV_RV8523, RV8523_CONTROL1, 1, data);
+}
+
+
+/*
+ * local functions
+ */
+
+/* cycles of one run, up to 2^17 cycles are counted */
+static uint32_t measure(void (*run)(void))
+{
+    uint32_t cycles;
+
+    TCCR1A = 0;
+    TCNT1 = 0;
+    TIFR1 = _BV(TOV1);
+    TCCR1B = _BV(CS10);
+    run();
+    TCCR1B = 0;
+    cycles = TCNT1;
+    if(TIFR1 & _BV(TOV1))
+        cycles += 0x10000;
+    return cycles;
+}
+
+
+/* timer1 with F_CPU/64 for operations up to 750ms, returns microseconds */
+static void slow_start(void)
+{
+    TCCR1A = 0;
+    TCNT1 = 0;
+    TIFR1 = _BV(TOV1);
+    TCCR1B = _BV(CS11) | _BV(CS10);
+}
+
+static uint32_t slow_stop(void)
+{
+    uint32_t ticks;
+
+    TCCR1B = 0;
+    ticks = TCNT1;
+    if(TIFR1 & _BV(TOV1))
+        ticks += 0x10000;
+    return ticks * 6400UL / (F_CPU/10000);
+}
+
+static uint32_t cycles_to_us(uint32_t cycles)
+{
+    return cycles * 100UL / (F_CPU/10000);
+}
+
+/* print time and status polls of one flash operation started by slow_start */
+static void print_flash_op(const char *name, uint32_t polls)
+{
+    uint32_t us = slow_stop();
+    printf_P(PSTR("            %-14S %7luus %5lu polls\n"), name, us, flash_status_polls() - polls);
+}
+
+
+/*
+ * global functions
+ */
+
+uint8_t bench_run_kernels(void)
+{
+    uint32_t overhead, cycles, ref;
+    uint16_t per_op;
+    uint8_t i, ops, bytes;
+    uint8_t regressions = 0;
+    void (*run)(void);
+
+    /* realistic input: bcd time and date digits */
+    for(i=0; i<BENCH_DATA_SIZE; ++i)
+        data[i] = dec_to_bcd((i * 37) % 60);
+    sink32 = rv8523_toTimestamp(21, 2, 19, 12, 0, 0);
+
+    overhead = measure(run_empty);
+    printf_P(PSTR("            kernel       cyc/op   ns/op cyc/byte  cyc/run reference\n"));
+    for(i=0; i<NUM_KERNELS; ++i){
+        run = (void (*)(void))pgm_read_word(&kernels[i].run);
+        ops = pgm_read_byte(&kernels[i].ops);
+        bytes = pgm_read_byte(&kernels[i].bytes);
+
+        cycles = measure(run);
+        cycles = (cycles > overhead) ? cycles - overhead : 0;
+        per_op = cycles / ops;
+        printf_P(PSTR("            %-12S %6u %7lu "), (const char *)pgm_read_word(&kernels[i].name),
+                 per_op, (uint32_t)per_op * 100000UL / (F_CPU/10000));
+        if(bytes)
+            printf_P(PSTR("%8lu "), cycles / bytes);
+        else
+            printf_P(PSTR("       - "));
+        printf_P(PSTR("%8lu "), cycles);
+
+        /* the bus clocks and the log contents change the io kernels */
+        ref = pgm_read_dword(&kernels[i].ref);
+        if(pgm_read_byte(&kernels[i].io)){
+            printf_P(PSTR("        - io\n"));
+        }else if(ref == 0){
+            printf_P(PSTR("        - FAIL\n"));   // a gate without baseline passes anything
+            ++regressions;
+        }else if(cycles > ref + ref/8){
+            printf_P(PSTR("%9lu FAIL\n"), ref);
+            ++regressions;
+        }else{
+            printf_P(PSTR("%9lu ok\n"), ref);
+        }
+    }
+    return regressions;
+}
+
+
+void bench_run_hw(void)
+{
+    uint16_t pageno = log_scratch_page();
+    uint16_t n, k;
+    uint32_t overhead, cycles, polls;
+    uint8_t div;
+
+    for(n=0; n<BENCH_DATA_SIZE; ++n)
+        data[n] = n;
+
+    /* SPI: 64 data bytes plus 4 command bytes per flash_read */
+    overhead = measure(run_empty);
+    for(div=2; div; div<<=1){
+        flash_read(0, 0, data, 1);     // selects the flash with its own setting
+        spi_masterSetClockDiv(div);    // kept until another device is used
+        cycles = measure(run_flash_read) - overhead;
+        printf_P(PSTR("            spi fck/%-3u %8lu B/s\n"), div,
+                 (uint32_t)(BENCH_DATA_SIZE+4) * F_CPU / cycles);
+    }
+    spi_masterSetSysClock(F_CPU >> clock_get_div());   // back to the device setting
+
+    /* flash page operations on the scratch block, outside of the log */
+    slow_start();
+    flash_stream_open(pageno, 0);
+    for(n=flash_page_size(); n; n-=k){
+        k = (n < BENCH_DATA_SIZE) ? n : BENCH_DATA_SIZE;
+        flash_stream_read(data, k);
+    }
+    flash_stream_close();
+    printf_P(PSTR("            %-14S %7luus\n"), PSTR("page read"), slow_stop());  // no status polls
+
+    polls = flash_status_polls();
+    slow_start();
+    flash_erase_block(pageno);
+    print_flash_op(PSTR("block erase"), polls);
+
+    flash_buffer_write(FLASH_BUF1, 0, data, BENCH_DATA_SIZE);
+    polls = flash_status_polls();
+    slow_start();
+    flash_buffer_program(FLASH_BUF1, pageno, false);
+    print_flash_op(PSTR("page program"), polls);
+
+    /* the verify step of flash_buffer_commit */
+    polls = flash_status_polls();
+    slow_start();
+    flash_buffer_verify(FLASH_BUF1, pageno);
+    print_flash_op(PSTR("page compare"), polls);
+
+    polls = flash_status_polls();
+    slow_start();
+    flash_buffer_program(FLASH_BUF1, pageno, true);
+    print_flash_op(PSTR("erase+program"), polls);
+
+    /* I2C transactions with the RTC */
+    printf_P(PSTR("            i2c probe      %7luus\n"), cycles_to_us(measure(run_i2c_probe) - overhead));
+    printf_P(PSTR("            i2c read 1B    %7luus\n"), cycles_to_us(measure(run_i2c_read) - overhead));
+    printf_P(PSTR("            rtc read 7B    %7luus\n"), cycles_to_us(measure(run_rtc_read) - overhead));
+
+    /* UART: the line of dashes itself is the payload */
+    printf_P(PSTR("            uart "));
+    slow_start();
+    for(n=0; n<BENCH_DATA_SIZE; ++n)
+        putchar('-');
+    cycles = slow_stop();
+    printf_P(PSTR(" %lu B/s\n"), (uint32_t)BENCH_DATA_SIZE * 1000000UL / cycles);
+}
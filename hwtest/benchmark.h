@@ -0,0 +1,48 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file benchmark.h
+ * Cycle counting benchmark of the firmware kernels
+ *
+ * Each kernel is timed with timer1 running at the cpu clock. The pure
+ * cpu kernels are compared with the reference cycle counts in
+ * bench_ref.h, a kernel needing more than 1/8 above its reference is a
+ * regression. Kernels bound by the SPI or I2C clock or by the contents
+ * of the log are only reported.
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+#include <stdbool.h>
+
+
+/**
+ * @brief bench_run_kernels
+ *
+ * @desc run the kernels and print cycles/op, ns/op and cycles/byte
+ *       together with the comparison against the reference
+ * @note uses timer1
+ *
+ * @return number of kernels slower than their reference allows or
+ *         without a recorded reference
+ */
+uint8_t bench_run_kernels(void);
+
+
+/**
+ * @brief bench_run_hw
+ *
+ * @desc measure and print the hardware performance: SPI throughput per
+ *       clock divider, flash page read/program/erase times with their
+ *       status polls, I2C latency to the RTC and UART throughput
+ * @note uses timer1, overwrites the scratch block of the log and flash
+ *       buffer 1, the open LOG_RAW page has to be committed first
+ */
+void bench_run_hw(void);
+
+#endif
@@ -0,0 +1,171 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file bh1750.c
+ * Driver for the ROHM BH1750FVI ambient light sensor
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+
+#include "clock.h"
+#include "i2creg.h"
+#include "sensor.h"
+#include "bh1750.h"
+
+/* instructions */
+#define BH1750_POWER_DOWN    0x00
+#define BH1750_POWER_ON      0x01
+#define BH1750_ONE_TIME_H    0x20  /**< 1lx resolution at the default MTreg */
+#define BH1750_MTREG_HIGH    0x40  /**< | MTreg[7:5] */
+#define BH1750_MTREG_LOW     0x60  /**< | MTreg[4:0] */
+
+/* measurement time register, the conversion time scales with it.
+   The upper limit keeps a conversion below 350ms. */
+#define MTREG_DEFAULT  69
+#define MTREG_MIN      31    /**< up to 120klx, direct sunlight */
+#define MTREG_MAX      127   /**< 0.54lx resolution */
+#define CONV_MS_MAX    180   /**< at MTREG_DEFAULT */
+
+/* accepted count range and the count aimed at when ranging, the target
+   leaves headroom for the light getting three times brighter */
+#define COUNT_LOW      1000
+#define COUNT_HIGH     60000
+#define COUNT_TARGET   20000
+
+static uint8_t mtreg = MTREG_DEFAULT;
+static uint8_t conversions;
+
+
+/*
+ * local functions
+ */
+
+static bool command(uint8_t cmd)
+{
+    return i2c_send(DEV_BH1750, &cmd, 1);
+}
+
+static bool set_mtreg(uint8_t mt)
+{
+    mtreg = mt;
+    return command(BH1750_MTREG_HIGH | (mt >> 5))
+        && command(BH1750_MTREG_LOW | (mt & 0x1f));
+}
+
+static uint16_t conv_ms(void)
+{
+    return ((uint16_t)CONV_MS_MAX * mtreg + MTREG_DEFAULT-1) / MTREG_DEFAULT;
+}
+
+static bool read_count(uint16_t *count)
+{
+    uint8_t val[2];
+
+    if(!i2c_receive(DEV_BH1750, val, 2))
+        return false;
+    *count = ((uint16_t)val[0] << 8) | val[1];
+    return true;
+}
+
+/* MTreg bringing count to COUNT_TARGET, mtreg if count is fine already */
+static uint8_t range(uint16_t count)
+{
+    uint32_t mt;
+
+    if(count >= COUNT_LOW && count <= COUNT_HIGH)
+        return mtreg;
+    if(count == 0xffff)
+        return MTREG_MIN;    /* saturated, the real value is unknown */
+    if(count == 0)
+        return MTREG_MAX;
+    mt = (uint32_t)mtreg * COUNT_TARGET / count;
+    if(mt < MTREG_MIN)
+        return MTREG_MIN;
+    if(mt > MTREG_MAX)
+        return MTREG_MAX;
+    return mt;
+}
+
+
+/*
+ * driver functions
+ */
+
+static bool drv_probe(void)
+{
+    return i2c_probe(DEV_BH1750);
+}
+
+static bool drv_configure(void)
+{
+    return set_mtreg(mtreg) && command(BH1750_POWER_DOWN);
+}
+
+static uint16_t drv_trigger(void)
+{
+    conversions = 1;
+    command(BH1750_ONE_TIME_H);
+    return conv_ms();
+}
+
+static uint8_t drv_read(uint8_t *buf)
+{
+    uint16_t count;
+    uint32_t mlx;
+    uint8_t mt;
+
+    if(!read_count(&count))
+        return 0;
+
+    /* the second conversion is taken as it is */
+    mt = range(count);
+    if(mt != mtreg){
+        if(!set_mtreg(mt) || !command(BH1750_ONE_TIME_H))
+            return 0;
+        ++conversions;
+        clock_delay_ms(conv_ms());
+        if(!read_count(&count))
+            return 0;
+    }
+
+    /* lux = count / 1.2 * 69 / MTreg */
+    mlx = (uint32_t)count * 57500UL / mtreg;
+    memcpy(buf, &mlx, sizeof(mlx));
+    return sizeof(mlx);
+}
+
+static void drv_powerdown(void)
+{
+    command(BH1750_POWER_DOWN);
+}
+
+static const char name[] PROGMEM = "bh1750";
+
+const sensor_driver_t bh1750_driver PROGMEM = {
+    name, drv_probe, drv_configure, drv_trigger, drv_read, drv_powerdown
+};
+
+
+/*
+ * global functions
+ */
+
+uint32_t bh1750_millilux(const uint8_t *data)
+{
+    uint32_t mlx;
+    memcpy(&mlx, data, sizeof(mlx));
+    return mlx;
+}
+
+
+uint8_t bh1750_conversions(void)
+{
+    return conversions;
+}
@@ -0,0 +1,51 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file bh1750.h
+ * Driver for the ROHM BH1750FVI ambient light sensor
+ * for datasheet see
+ *  https://www.mouser.com/datasheet/2/348/bh1750fvi-e-186247.pdf
+ *
+ * Only one-time measurements are used, the sensor powers down by itself
+ * after each conversion. The measurement time register is adjusted after
+ * every sample so the count stays in range. If a conversion is out of
+ * range a second one with a corrected setting is done, so every sample
+ * needs at most two conversions. The awake time of the sensor is the
+ * latency reported by sensor_sample_all.
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#ifndef _BH1750_H_
+#define _BH1750_H_
+
+#include <stdint.h>
+
+#include "sensor.h"
+
+#ifndef DEV_BH1750
+#define DEV_BH1750  0x46  /**< I2C slave address with ADDR low, 0xb8 with ADDR high */
+#endif
+
+/** driver for the registry in sensor.c, the result is in millilux */
+extern const sensor_driver_t bh1750_driver;
+
+
+/**
+ * @brief bh1750_millilux
+ *
+ * @desc convert the result bytes of a reading to millilux
+ */
+uint32_t bh1750_millilux(const uint8_t *data);
+
+
+/**
+ * @brief bh1750_conversions
+ *
+ * @desc return the number of conversions the last sample needed, 1 or 2
+ */
+uint8_t bh1750_conversions(void);
+
+#endif
@@ -0,0 +1,100 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file clock.c
+ * Clock governor: runtime scaling of the system clock via CLKPR
+ * tested with Atmega 328P
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#include <avr/io.h>
+#include <avr/power.h>
+#include <util/delay_basic.h>
+
+#include "spi_master.h"
+#include "clock.h"
+
+static uint8_t div_shift = 0;
+static uint16_t loops_per_ms = F_CPU/4000;  /**< _delay_loop_2 takes 4 cycles */
+
+
+/*
+ * local functions
+ */
+
+/* UBRR for double speed mode, 0xffff if the baud rate is out of reach */
+static uint16_t calc_ubrr(uint32_t freq)
+{
+    uint32_t div = (freq + 4*CLOCK_UART_BAUD) / (8*CLOCK_UART_BAUD);
+    uint32_t real;
+
+    if(div == 0)
+        return 0xffff;
+    real = freq / (8*div);
+    if(((real > CLOCK_UART_BAUD) ? real - CLOCK_UART_BAUD : CLOCK_UART_BAUD - real)*50 > CLOCK_UART_BAUD)
+        return 0xffff;
+    return div - 1;
+}
+
+
+/*
+ * global functions
+ */
+
+bool clock_set_div(uint8_t shift)
+{
+    uint32_t freq;
+    uint16_t ubrr;
+    uint8_t twbr;
+
+    if(shift > 8)
+        return false;
+    freq = F_CPU >> shift;
+    ubrr = calc_ubrr(freq);
+    if((UCSR0B & _BV(TXEN0)) && ubrr == 0xffff)
+        return false;
+
+    /* let the last character leave the UART */
+    if(UCSR0B & _BV(TXEN0)){
+        loop_until_bit_is_set(UCSR0A, UDRE0);
+        clock_delay_us(12*1000000UL/CLOCK_UART_BAUD);
+    }
+
+    clock_prescale_set((clock_div_t)shift);
+    div_shift = shift;
+    loops_per_ms = (F_CPU/4000) >> shift;
+
+    if(ubrr != 0xffff){
+        UBRR0H = (unsigned char)(ubrr>>8);
+        UBRR0L = (unsigned char)ubrr;
+    }
+    /* a slower SCL than CLOCK_I2C_SCL is fine for the I2C devices */
+    twbr = (freq/CLOCK_I2C_SCL > 16) ? (freq/CLOCK_I2C_SCL - 16)/2 : 0;
+    TWBR = twbr;
+    spi_masterSetSysClock(freq);  // devices keep their max_hz
+    return true;
+}
+
+
+uint8_t clock_get_div(void)
+{
+    return div_shift;
+}
+
+
+void clock_delay_us(uint16_t us)
+{
+    uint16_t loops = (uint32_t)us * loops_per_ms / 1000;
+    if(loops)
+        _delay_loop_2(loops);
+}
+
+
+void clock_delay_ms(uint16_t ms)
+{
+    for(; ms>0; --ms)
+        _delay_loop_2(loops_per_ms);
+}
@@ -0,0 +1,68 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file clock.h
+ * Clock governor: runtime scaling of the system clock via CLKPR
+ * tested with Atmega 328P
+ *
+ * The peripherals clocked from the system clock are adjusted with every
+ * change: UART baud rate register, TWI bit rate and SPI divider.
+ * _delay_us/_delay_ms are calculated for F_CPU at compile time, code
+ * running at a reduced clock uses clock_delay_us/clock_delay_ms instead.
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#ifndef _CLOCK_H_
+#define _CLOCK_H_
+
+#include <stdbool.h>
+
+#define CLOCK_UART_BAUD  115200UL  /**< baud rate kept by the governor */
+#define CLOCK_I2C_SCL    100000UL  /**< I2C clock, as in twimaster.c */
+#define CLOCK_SPI_FREQ   (F_CPU/16) /**< SPI clock of the flash */
+
+
+/**
+ * @brief clock_set_div
+ *
+ * @desc change the system clock to F_CPU/2^shift and adjust UART, TWI
+ *       and SPI. A pending UART transmission is completed first.
+ *
+ * @param shift  0 (F_CPU) .. 8 (F_CPU/256)
+ * @return false if the UART baud rate can't be reached within 2% at this
+ *         clock, the clock is left unchanged then
+ */
+bool clock_set_div(uint8_t shift);
+
+
+/**
+ * @brief clock_get_div
+ *
+ * @desc return the current clock divider as shift value, F_CPU/2^shift
+ */
+uint8_t clock_get_div(void);
+
+
+/**
+ * @brief clock_delay_us
+ *
+ * @desc busy wait for the given time at the current clock
+ *
+ * @param us  microseconds to wait, resolution is about 4 cpu cycles
+ */
+void clock_delay_us(uint16_t us);
+
+
+/**
+ * @brief clock_delay_ms
+ *
+ * @desc busy wait for the given time at the current clock
+ *
+ * @param ms  milliseconds to wait
+ */
+void clock_delay_ms(uint16_t ms);
+
+#endif
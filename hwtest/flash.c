@@ -2,7 +2,7 @@
  * -------------------------------------------------------------------------
  * @file flash.c
  * Access routines for Adesto flash
- * currently supporting AT45DB321E
+ * supporting the AT45DB041..AT45DB641E family
  *
  * Version 0.1
  *
@@ -10,11 +10,14 @@
  * -------------------------------------------------------------------------
  */
 
+#include <string.h>
 #include <avr/io.h>
+#include <avr/pgmspace.h>
 #include <util/delay.h>
 
 #include "hwconfig.h"
 #include "spi_master.h"
+#include "clock.h"
 #include "at45d321_cmds.h"
 
 #include "flash.h"
@@ -22,40 +25,274 @@
 //#define FLASH_CS_ACTIVE    (FLASH_DDR |= _BV(FLASH_NCS))
 //#define FLASH_CS_INACTIVE  (FLASH_DDR &= ~_BV(FLASH_NCS))
 
-#define FLASH_CS_ACTIVE    (PORTB &= ~_BV(FLASH_NCS))
-#define FLASH_CS_INACTIVE  (PORTB |= _BV(FLASH_NCS))
+/* an access while the bus is held, by an open stream or by a transaction
+   an ISR interrupted, would clock its command into the running transfer.
+   The global functions refuse it before touching the device, so the
+   claim of FLASH_CS_ACTIVE can't fail. */
+#define FLASH_REFUSE_IF_BUSY(...)  do{ if(spi_masterBusy()) return __VA_ARGS__; }while(0)
+
+#define FLASH_CS_ACTIVE    ((void)spi_masterBegin(&flash_dev))
+#define FLASH_CS_INACTIVE  spi_masterEnd(&flash_dev)
 #define FLASH_WP_INACTIVE  (PORTB |= _BV(FLASH_NWP))
 #define FLASH_WP_ACTIVE    (PORTB &= ~_BV(FLASH_NWP))
+#define FLASH_RESET_ACTIVE   (PORTB &= ~_BV(FLASH_NRESET))
+#define FLASH_RESET_INACTIVE (PORTB |= _BV(FLASH_NRESET))
+
+/* select the device, waking it up first if it is powered down */
+#define FLASH_SELECT       do{ if(pm_state != FLASH_PM_ACTIVE) flash_wake(); FLASH_CS_ACTIVE; }while(0)
+
+
+#if(FLASH_FAULT_INJECTION)
+uint16_t flash_fault_delay = 0;
+#endif
+
+/* the flash on the shared SPI bus, the SPI clock is kept at CLOCK_SPI_FREQ */
+static const spi_device_t flash_dev = {&PORTB, _BV(FLASH_NCS), SPI_MODE0, CLOCK_SPI_FREQ};
+
+/** geometry of a device, selected by the density code of the JEDEC ID */
+typedef struct {
+    uint8_t  density;  /**< JEDEC ID byte 1, bits 4..0 */
+    uint8_t  p2_shift; /**< log2 of the power-of-two page size */
+    uint16_t pages;    /**< number of pages */
+} flash_geometry_t;
+
+static const flash_geometry_t geometries[] PROGMEM = {
+    {0x04, 8,  2048},  /* AT45DB041,  512kB */
+    {0x05, 8,  4096},  /* AT45DB081,  1MB */
+    {0x06, 9,  4096},  /* AT45DB161,  2MB */
+    {0x07, 9,  8192},  /* AT45DB321,  4MB */
+    {0x08, 8, 32768},  /* AT45DB641E, 8MB */
+};
+
+/* the AT45DB321E is assumed until flash_init identified the device */
+static uint16_t num_pages = 8192;
+static uint8_t p2_shift = 9;      /**< log2 of the power-of-two page size */
+static uint16_t page_size = 512;  /**< current page size, 256/264 or 512/528 */
+static uint8_t addr_shift = 9;    /**< bits of the byte offset in an address */
+
+enum {FLASH_PM_ACTIVE=0, FLASH_PM_DEEP, FLASH_PM_ULTRADEEP};
+static uint8_t pm_state = FLASH_PM_ACTIVE;
+static uint8_t buf_dirty = 0;     /**< bit n set: buffer n holds data not programmed yet */
+static bool stream_open = false;  /**< continuous read in progress */
+static bool erase_pending = false; /**< flash_erase_block_start not seen completed */
+static bool erase_suspended = false;
+static uint16_t suspends = 0;
+static uint32_t polls = 0;        /**< status reads of flash_wait_ready */
+static flash_pm_stats_t pm_stats;
+
+
+/*
+ * local functions
+ */
+
+static void flash_wake(void)
+{
+    if(pm_state == FLASH_PM_DEEP)
+        flash_resume_deep_powerdown();
+    else
+        flash_resume_ultradeep_powerdown();
+}
+
+/* send a command followed by the 3 address bytes: pageno | byte offset */
+static void flash_cmd_addr(uint8_t cmd, uint16_t pageno, uint16_t offset)
+{
+    uint32_t addr = ((uint32_t)pageno << addr_shift) | offset;
+    spi_masterTransmit(cmd);
+    spi_masterTransmit((addr>>16) & 0xff);
+    spi_masterTransmit((addr>>8) & 0xff);
+    spi_masterTransmit(addr & 0xff);
+}
 
+/* standard DataFlash pages carry 1/32 extra bytes and one more offset bit */
+static void set_page_size(bool power2)
+{
+    page_size = 1 << p2_shift;
+    addr_shift = p2_shift;
+    if(!power2){
+        page_size += 1 << (p2_shift-5);
+        ++addr_shift;
+    }
+}
 
-#define FLASH_PAGE_SIZE 512 /**< value can be either 512 or 528 */
+/* select the geometry matching the JEDEC ID, unknown devices get no pages */
+static void set_geometry(const uint8_t *id)
+{
+    uint8_t i;
+
+    num_pages = 0;
+    if(id[0] != 0x1f || (id[1] & 0xe0) != 0x20)  /* Adesto DataFlash family */
+        return;
+    for(i=0; i<sizeof(geometries)/sizeof(geometries[0]); ++i){
+        if(pgm_read_byte(&geometries[i].density) == (id[1] & 0x1f)){
+            p2_shift = pgm_read_byte(&geometries[i].p2_shift);
+            num_pages = pgm_read_word(&geometries[i].pages);
+            return;
+        }
+    }
+}
+
+static void erase_done(void)
+{
+    erase_pending = false;
+    FLASH_WP_ACTIVE;
+}
+
+/* pause a background erase for a read or buffer access, tSUSP is some 10us.
+   An erase completing meanwhile is fine, the device ignores the command.
+   Accesses don't nest, the bus is refused while a stream is open. */
+static void erase_suspend(void)
+{
+    uint8_t status[2];
+
+    if(!erase_pending)
+        return;
+    if(flash_get_status(status) & 0x80){  // ready, the erase is done
+        erase_done();
+        return;
+    }
+    FLASH_SELECT;
+    spi_masterTransmit(FLASHCMD_PROGRAM_ERASE_SUSPEND);
+    FLASH_CS_INACTIVE;
+    flash_wait_ready();
+    erase_suspended = true;
+    ++suspends;
+}
+
+static void erase_resume(void)
+{
+    if(!erase_suspended)
+        return;
+    FLASH_SELECT;
+    spi_masterTransmit(FLASHCMD_PROGRAM_ERASE_RESUME);
+    FLASH_CS_INACTIVE;
+    erase_suspended = false;
+}
+
+/* programming and erasing wait for a background erase to complete */
+static void erase_finish(void)
+{
+    if(!erase_pending)
+        return;
+    flash_wait_ready();
+    erase_done();
+}
+
+/* let the flash compare a page with one of its buffers, status bit 6 is set on mismatch */
+static bool flash_compare(uint8_t cmd, uint16_t pageno)
+{
+    uint8_t status[2];
+    FLASH_SELECT;
+    flash_cmd_addr(cmd, pageno, 0);
+    FLASH_CS_INACTIVE;
+    flash_wait_ready();
+    return (flash_get_status(status) & 0x40) == 0;
+}
+
+/* identify the device and configure its page size */
+static void identify(void)
+{
+    uint8_t status[2];
+    uint8_t id[5];
+
+    flash_get_id(id);
+    set_geometry(id);
+
+    /* status bit 0 tells the configured page size */
+    flash_get_status(status);
+#if defined(FLASH_POWER2_PAGES) && (FLASH_POWER2_PAGES == 1)
+    if(!(status[0] & 0x01))
+        flash_conf_power2_size();
+    set_page_size(true);
+#elif defined(FLASH_POWER2_PAGES) && (FLASH_POWER2_PAGES == 0)
+    if(status[0] & 0x01)
+        flash_conf_standard_size();
+    set_page_size(false);
+#else
+    set_page_size(status[0] & 0x01);
+#endif
+}
+
+
+/*
+ * global functions
+ */
 
 
 void flash_init(void)
 {
+    FLASH_REFUSE_IF_BUSY();
     /* pull reset line */
-    FLASH_DDR |= _BV(FLASH_NRESET);
-    _delay_us(10);                  /* 10us delay required */
-    FLASH_DDR &= ~_BV(FLASH_NRESET);
-    _delay_us(35);                  /* wait for 35us */
+    FLASH_RESET_ACTIVE;
+    clock_delay_us(10);             /* 10us delay required */
+    FLASH_RESET_INACTIVE;
+    clock_delay_us(35);             /* wait for 35us */
+
+    identify();
+}
+
+
+void flash_attach(void)
+{
+    uint8_t status[2];
+
+    FLASH_REFUSE_IF_BUSY();
+    /* the cpu may have been reset while the flash was powered down or busy */
+    flash_resume_ultradeep_powerdown();
+    flash_resume_deep_powerdown();
+
+    /* or while a block erase was suspended for a read, the device keeps it
+       suspended until told otherwise. Status byte 2 bit 3 (ES) tells. */
+    flash_get_status(status);
+    if(status[1] & 0x08){
+        FLASH_WP_INACTIVE;
+        FLASH_SELECT;
+        spi_masterTransmit(FLASHCMD_PROGRAM_ERASE_RESUME);
+        FLASH_CS_INACTIVE;
+        erase_pending = true;
+    }
+    erase_finish();
+    flash_wait_ready();
+    buf_dirty = _BV(FLASH_BUF1) | _BV(FLASH_BUF2);  // unknown, keep them
+    identify();
+}
+
+
+uint16_t flash_page_size(void)
+{
+    return page_size;
+}
+
+
+uint16_t flash_num_pages(void)
+{
+    return num_pages;
 }
 
 
 void flash_wait_ready(void)
 {
     uint8_t val0, val1;
-    FLASH_CS_ACTIVE;
+    FLASH_REFUSE_IF_BUSY();
+    FLASH_SELECT;
     spi_masterTransmit(FLASHCMD_STATUS_REGISTER_READ);
     do{
         val0 = spi_masterTransmit(0xff);
         val1 = spi_masterTransmit(0xff);
+        ++polls;
     }while(!(val0 & 0x80));
     FLASH_CS_INACTIVE;
 }
 
+uint32_t flash_status_polls(void)
+{
+    return polls;
+}
+
 uint8_t flash_get_status(uint8_t *buf)
 {
-    FLASH_CS_ACTIVE;
+    *buf = *(buf+1) = 0;
+    FLASH_REFUSE_IF_BUSY(0);
+    FLASH_SELECT;
     spi_masterTransmit(FLASHCMD_STATUS_REGISTER_READ);
     *buf = spi_masterTransmit(0xff);
     *(buf+1) = spi_masterTransmit(0xff);
@@ -67,7 +304,9 @@ uint8_t flash_get_status(uint8_t *buf)
 void flash_get_id(uint8_t *buf)
 {
     int i;
-    FLASH_CS_ACTIVE;
+    memset(buf, 0, 5);
+    FLASH_REFUSE_IF_BUSY();
+    FLASH_SELECT;
     spi_masterTransmit(FLASHCMD_MANUFACTURER_AND_DEVICE_ID_READ);
     for(i=0; i<5; ++i, ++buf)
         *buf = spi_masterTransmit(0xff);
@@ -76,58 +315,199 @@ void flash_get_id(uint8_t *buf)
 
 void flash_conf_power2_size(void)
 {
-    FLASH_CS_ACTIVE;
+    FLASH_REFUSE_IF_BUSY();
+    FLASH_SELECT;
     spi_masterTransmit(FLASHCMD_CONFIGURE_POWER_OF_TWO_PAGE_SIZE0);
     spi_masterTransmit(FLASHCMD_CONFIGURE_POWER_OF_TWO_PAGE_SIZE1);
     spi_masterTransmit(FLASHCMD_CONFIGURE_POWER_OF_TWO_PAGE_SIZE2);
     spi_masterTransmit(FLASHCMD_CONFIGURE_POWER_OF_TWO_PAGE_SIZE3);
     FLASH_CS_INACTIVE;
     flash_wait_ready();
+    set_page_size(true);
 }
 
 void flash_conf_standard_size(void)
 {
-    FLASH_CS_ACTIVE;
+    FLASH_REFUSE_IF_BUSY();
+    FLASH_SELECT;
     spi_masterTransmit(FLASHCMD_CONFIGURE_STANDARD_DATAFLASH_PAGE_SIZE0);
     spi_masterTransmit(FLASHCMD_CONFIGURE_STANDARD_DATAFLASH_PAGE_SIZE1);
     spi_masterTransmit(FLASHCMD_CONFIGURE_STANDARD_DATAFLASH_PAGE_SIZE2);
     spi_masterTransmit(FLASHCMD_CONFIGURE_STANDARD_DATAFLASH_PAGE_SIZE3);
     FLASH_CS_INACTIVE;
     flash_wait_ready();
+    set_page_size(false);
 }
 
 
 void flash_read_page(uint8_t *buf, uint16_t pageno)
 {
-    FLASH_CS_ACTIVE;
-    spi_masterTransmit(FLASHCMD_CONTINUOUS_ARRAY_READ_LOW_FREQUENCY);
-    spi_masterTransmit((pageno>>7) & 0x3f);   // 6bit of pageno
-    spi_masterTransmit((pageno<<1) & 0xfe);   // 7bit of pageno
-    spi_masterTransmit(pageno & 0xff);        // dummy address
-    for(int i=0; i<FLASH_PAGE_SIZE; ++i)
-        *(buf++) = spi_masterTransmit(0xff);
-    FLASH_CS_INACTIVE;
+    flash_read(pageno, 0, buf, page_size);
 }
 
-void flash_write_page(uint16_t pageno, const uint8_t *buf)
+bool flash_write_page(uint16_t pageno, const uint8_t *buf)
 {
+    if(pageno >= num_pages)
+        return false;
+    FLASH_REFUSE_IF_BUSY(false);
+    erase_finish();
     FLASH_WP_INACTIVE;
-    FLASH_CS_ACTIVE;
-    spi_masterTransmit(FLASHCMD_MAIN_MEM_PAGE_PROGRAM_THROUGH_BUF1_ERASE);
-    spi_masterTransmit((pageno>>7) & 0x3f);   // 6bit of pageno
-    spi_masterTransmit((pageno<<1) & 0xfe);   // 7bit of pageno
-    spi_masterTransmit(pageno & 0xff);        // dummy address
-    for(int i=0; i<FLASH_PAGE_SIZE; ++i)
+    FLASH_SELECT;
+    flash_cmd_addr(FLASHCMD_MAIN_MEM_PAGE_PROGRAM_THROUGH_BUF1_ERASE, pageno, 0);
+    for(uint16_t i=0; i<page_size; ++i)
         spi_masterTransmit(*(buf++));
     FLASH_CS_INACTIVE;
+    buf_dirty &= ~_BV(FLASH_BUF1);
+    flash_wait_ready(); // wait until erase+write completed
+    FLASH_WP_ACTIVE;
+#if(FLASH_VERIFY)
+    return flash_compare(FLASHCMD_MAIN_MEM_PAGE_TO_BUFFER1_COMPARE, pageno);
+#else
+    return true;
+#endif
+}
+
+void flash_read(uint16_t pageno, uint16_t offset, uint8_t *buf, uint16_t n)
+{
+    if(spi_masterBusy()){
+        memset(buf, 0xff, n);   // like a read beyond the end
+        return;
+    }
+    flash_stream_open(pageno, offset);
+    flash_stream_read(buf, n);
+    flash_stream_close();
+}
+
+void flash_stream_open(uint16_t pageno, uint16_t offset)
+{
+    FLASH_REFUSE_IF_BUSY();
+    stream_open = pageno < num_pages;  /* beyond the end reads like erased flash */
+    if(!stream_open)
+        return;
+    erase_suspend();
+    FLASH_SELECT;
+    flash_cmd_addr(FLASHCMD_CONTINUOUS_ARRAY_READ_LOW_FREQUENCY, pageno, offset);
+}
+
+void flash_stream_read(uint8_t *buf, uint16_t n)
+{
+    for(; n>0; --n)
+        *(buf++) = stream_open ? spi_masterTransmit(0xff) : 0xff;
+}
+
+void flash_stream_close(void)
+{
+    if(stream_open){
+        FLASH_CS_INACTIVE;
+        erase_resume();
+    }
+    stream_open = false;
+}
+
+void flash_buffer_write(uint8_t bufno, uint16_t offset, const uint8_t *buf, uint16_t n)
+{
+    FLASH_REFUSE_IF_BUSY();
+    erase_suspend();
+    FLASH_SELECT;
+    flash_cmd_addr((bufno == FLASH_BUF1) ? FLASHCMD_BUF1_WRITE : FLASHCMD_BUF2_WRITE,
+                   0, offset);  // upper address bits are don't care
+    for(; n>0; --n)
+        spi_masterTransmit(*(buf++));
+    FLASH_CS_INACTIVE;
+    erase_resume();
+    buf_dirty |= _BV(bufno);
+}
+
+bool flash_buffer_commit(uint8_t bufno, uint16_t pageno, bool erase)
+{
+    if(!flash_buffer_program(bufno, pageno, erase))
+        return false;
+#if(FLASH_VERIFY)
+    return flash_buffer_verify(bufno, pageno);
+#else
+    return true;
+#endif
+}
+
+bool flash_buffer_program(uint8_t bufno, uint16_t pageno, bool erase)
+{
+    uint8_t cmd;
+
+    if(pageno >= num_pages)
+        return false;
+    FLASH_REFUSE_IF_BUSY(false);
+    if(bufno == FLASH_BUF1)
+        cmd = erase ? FLASHCMD_BUF1_TO_MAIN_MEM_PAGE_WITH_ERASE : FLASHCMD_BUF1_TO_MAIN_MEM_PAGE_WITHOUT_ERASE;
+    else
+        cmd = erase ? FLASHCMD_BUF2_TO_MAIN_MEM_PAGE_WITH_ERASE : FLASHCMD_BUF2_TO_MAIN_MEM_PAGE_WITHOUT_ERASE;
+    erase_finish();
+    FLASH_WP_INACTIVE;
+    FLASH_SELECT;
+    flash_cmd_addr(cmd, pageno, 0);
+    FLASH_CS_INACTIVE;
+    buf_dirty &= ~_BV(bufno);
+#if(FLASH_FAULT_INJECTION)
+    if(flash_fault_delay){
+        for(; flash_fault_delay>0; --flash_fault_delay)
+            _delay_us(10);
+        FLASH_RESET_ACTIVE;   // aborts the running erase/program operation
+        _delay_us(10);
+        FLASH_RESET_INACTIVE;
+    }
+#endif
     flash_wait_ready(); // wait until erase+write completed
     FLASH_WP_ACTIVE;
+    return true;
+}
+
+bool flash_buffer_verify(uint8_t bufno, uint16_t pageno)
+{
+    FLASH_REFUSE_IF_BUSY(false);
+    return flash_compare((bufno == FLASH_BUF1) ? FLASHCMD_MAIN_MEM_PAGE_TO_BUFFER1_COMPARE
+                                               : FLASHCMD_MAIN_MEM_PAGE_TO_BUFFER2_COMPARE, pageno);
+}
+
+void flash_erase_block(uint16_t pageno)
+{
+    FLASH_REFUSE_IF_BUSY();
+    flash_erase_block_start(pageno);
+    erase_finish();
+}
+
+void flash_erase_block_start(uint16_t pageno)
+{
+    if(pageno >= num_pages)
+        return;
+    FLASH_REFUSE_IF_BUSY();
+    erase_finish();
+    FLASH_WP_INACTIVE;
+    FLASH_SELECT;
+    flash_cmd_addr(FLASHCMD_BLOCK_ERASE, pageno & ~(FLASH_BLOCK_PAGES-1), 0);
+    FLASH_CS_INACTIVE;
+    erase_pending = true;   // nWP stays inactive for the resume commands
+}
+
+bool flash_busy(void)
+{
+    uint8_t status[2];
+
+    FLASH_REFUSE_IF_BUSY(erase_pending);
+    if(erase_pending && !erase_suspended && (flash_get_status(status) & 0x80))
+        erase_done();
+    return erase_pending;
+}
+
+uint16_t flash_erase_suspends(void)
+{
+    return suspends;
 }
 
 void flash_erase_chip(void)
 {
+    FLASH_REFUSE_IF_BUSY();
+    erase_finish();
     FLASH_WP_INACTIVE;
-    FLASH_CS_ACTIVE;    
+    FLASH_SELECT;    
     spi_masterTransmit(FLASHCMD_CHIP_ERASE0);
     spi_masterTransmit(FLASHCMD_CHIP_ERASE1);
     spi_masterTransmit(FLASHCMD_CHIP_ERASE2);
@@ -140,31 +520,68 @@ void flash_erase_chip(void)
 
 void flash_enter_deep_powerdown(void)
 {
+    FLASH_REFUSE_IF_BUSY();
     FLASH_CS_ACTIVE;    
     spi_masterTransmit(FLASHCMD_DEEP_POWER_DOWN);
     FLASH_CS_INACTIVE;
+    pm_state = FLASH_PM_DEEP;
 }
 
 void flash_resume_deep_powerdown(void)
 {
+    FLASH_REFUSE_IF_BUSY();
     FLASH_CS_ACTIVE;    
     spi_masterTransmit(FLASHCMD_RESUME_FROM_DEEP_POWER_DOWN);
     FLASH_CS_INACTIVE;
-    _delay_us(35);    // wait for tRDPD=35us
+    clock_delay_us(35);  // wait for tRDPD=35us
+    pm_state = FLASH_PM_ACTIVE;
+    ++pm_stats.deep_wakes;
+    pm_stats.wake_us += 35;
 }
 
 
 void flash_enter_ultradeep_powerdown(void)
 {
+    FLASH_REFUSE_IF_BUSY();
     FLASH_CS_ACTIVE;    
     spi_masterTransmit(FLASHCMD_ULTRA_DEEP_POWER_DOWN);
     FLASH_CS_INACTIVE;
+    pm_state = FLASH_PM_ULTRADEEP;
+    buf_dirty = 0;      // buffer content is gone
 }
 
 void flash_resume_ultradeep_powerdown(void)
 {
+    FLASH_REFUSE_IF_BUSY();
     FLASH_CS_ACTIVE;    
     asm("NOP");         // wait for tCSLU = 20ns
     FLASH_CS_INACTIVE;
-    _delay_us(180);      // wait for tXUDPD = 180us    
+    clock_delay_us(180); // wait for tXUDPD = 180us
+    pm_state = FLASH_PM_ACTIVE;
+    ++pm_stats.ultradeep_wakes;
+    pm_stats.wake_us += 180;
+}
+
+
+void flash_sleep(uint16_t idle_ms)
+{
+    FLASH_REFUSE_IF_BUSY();
+    if(pm_state != FLASH_PM_ACTIVE || flash_busy())
+        return;   // power down commands are ignored while erasing
+    if(buf_dirty || idle_ms < FLASH_ULTRADEEP_MIN_MS)
+        flash_enter_deep_powerdown();
+    else
+        flash_enter_ultradeep_powerdown();
+}
+
+
+bool flash_buffer_dirty(void)
+{
+    return buf_dirty != 0;
+}
+
+
+void flash_get_pm_stats(flash_pm_stats_t *stats)
+{
+    *stats = pm_stats;
 }
@@ -2,7 +2,8 @@
  * -------------------------------------------------------------------------
  * @file flash.h
  * Access routines for Adesto flash
- * currently supporting AT45DB321E
+ * supporting the AT45DB041..AT45DB641E family, the geometry is
+ * selected from the JEDEC ID during flash_init
  *
  * Version 0.1
  *
@@ -13,15 +14,71 @@
 #ifndef _FLASH_H_
 #define _FLASH_H_
 
+#include <stdbool.h>
+
+#define FLASH_PAGE_SIZE_MAX 528 /**< largest page, size of page buffers */
+#define FLASH_BLOCK_PAGES   8   /**< pages erased by flash_erase_block */
+
+#define FLASH_BUF1  1  /**< SRAM buffer 1 of the device */
+#define FLASH_BUF2  2  /**< SRAM buffer 2 of the device */
+
+/* define FLASH_POWER2_PAGES to 1 (256/512 bytes) or 0 (264/528 bytes) to
+   force the page size during flash_init, otherwise the configured size
+   of the device is used */
+
+#ifndef FLASH_VERIFY
+#define FLASH_VERIFY 1  /**< compare programmed pages with the SRAM buffer */
+#endif
+
+#ifndef FLASH_ULTRADEEP_MIN_MS
+/** idle time from which flash_sleep prefers ultra-deep power down. Below
+    this the energy of the longer wake up (180us vs 35us) exceeds the
+    saving of the lower sleep current. */
+#define FLASH_ULTRADEEP_MIN_MS 200
+#endif
+
+#ifndef FLASH_FAULT_INJECTION
+#define FLASH_FAULT_INJECTION 0  /**< set to 1 to allow aborting program operations */
+#endif
+
 
 /**
  * @brief flash_init
  *
- * @desc setup the flash device
- *
+ * @desc setup the flash device, identify its geometry and detect its page size
+ * @note devices not found in the geometry table get 0 pages, all accesses fail
  */
 void flash_init(void);
 
+
+/**
+ * @brief flash_attach
+ *
+ * @desc take over a device that kept running during a warm boot of the
+ *       cpu: no reset pulse, it is woken up, a suspended erase is resumed,
+ *       a running program or erase is allowed to complete and the geometry
+ *       is read again
+ */
+void flash_attach(void);
+
+
+/**
+ * @brief flash_page_size
+ *
+ * @desc return the current page size of the flash device
+ *
+ * @return 256/264 or 512/528 depending on device and configuration
+ */
+uint16_t flash_page_size(void);
+
+
+/**
+ * @brief flash_num_pages
+ *
+ * @desc return the number of pages of the detected device
+ */
+uint16_t flash_num_pages(void);
+
 /**
  * @brief flash_wait_ready
  *
@@ -30,6 +87,13 @@ void flash_init(void);
  */
 void flash_wait_ready(void);
 
+/**
+ * @brief flash_status_polls
+ *
+ * @desc return the number of status reads flash_wait_ready needed since boot
+ */
+uint32_t flash_status_polls(void);
+
 /**
  * @brief flash_get_status
  *
@@ -53,6 +117,7 @@ void flash_get_id(uint8_t *buf);
  * @brief flash_conf_power2_size
  *
  * @desc configure the flash with a pagesize of 512 bytes
+ * @note the setting is nonvolatile, avoid calling it on every boot
  */
 void flash_conf_power2_size(void);
 
@@ -61,6 +126,7 @@ void flash_conf_power2_size(void);
  * @brief flash_conf_standard_size
  *
  * @desc configure the flash with a pagesize of 528 bytes
+ * @note the setting is nonvolatile, avoid calling it on every boot
  */
 void flash_conf_standard_size(void);
 
@@ -70,8 +136,8 @@ void flash_conf_standard_size(void);
  *
  * @desc read one page (=512/528 bytes) from the flash
  * 
- * @param *buf   buffer filled with the data from flash
- * @param pageno specifies the page number, valid values from 0-8191
+ * @param *buf   buffer of FLASH_PAGE_SIZE_MAX bytes filled with the data from flash
+ * @param pageno specifies the page number, valid values from 0 to flash_num_pages()-1
  */
 void flash_read_page(uint8_t *buf, uint16_t pageno);
 
@@ -80,22 +146,225 @@ void flash_read_page(uint8_t *buf, uint16_t pageno);
  *
  * @desc write one page (=512/528 bytes) to the flash
  * 
- * @param pageno specifies the page number, valid values from 0-8191
+ * @param pageno specifies the page number, valid values from 0 to flash_num_pages()-1
+ * @param *buf   buffer containing flash_page_size() bytes
+ * @return true if the page verified ok (always true without FLASH_VERIFY),
+ *         false for pages beyond the end of the device
+ */
+bool flash_write_page(uint16_t pageno, const uint8_t *buf);
+
+
+/**
+ * @brief flash_read
+ *
+ * @desc read a part of a page from the flash
+ * @note the read continues into the following page if offset+n exceeds the page size
+ *
+ * @param pageno specifies the page number, valid values from 0 to flash_num_pages()-1
+ * @param offset first byte within the page
+ * @param *buf   buffer filled with the data from flash, 0xff beyond the last page
+ * @param n      number of bytes to read
+ */
+void flash_read(uint16_t pageno, uint16_t offset, uint8_t *buf, uint16_t n);
+
+
+/**
+ * @brief flash_stream_open
+ *
+ * @desc start a continuous read. The device stays selected and sends the
+ *       following bytes across page boundaries until flash_stream_close.
+ * @note no other flash function may be called while the stream is open,
+ *       they are refused without an access to the device: reads deliver
+ *       0xff, programs and verifies fail, everything else does nothing
+ * @note the read wraps from the last page to page 0
+ *
+ * @param pageno first page, valid values from 0 to flash_num_pages()-1
+ * @param offset first byte within the page
+ */
+void flash_stream_open(uint16_t pageno, uint16_t offset);
+
+
+/**
+ * @brief flash_stream_read
+ *
+ * @desc read the next bytes of an open stream
+ *
+ * @param *buf   buffer filled with the data, 0xff if the stream start was invalid
+ * @param n      number of bytes to read
+ */
+void flash_stream_read(uint8_t *buf, uint16_t n);
+
+
+/**
+ * @brief flash_stream_close
+ *
+ * @desc end a continuous read and deselect the device
+ */
+void flash_stream_close(void);
+
+
+/**
+ * @brief flash_buffer_write
+ *
+ * @desc write data into one of the SRAM buffers of the flash without programming it
+ * @note flash_write_page uses buffer 1 as well and destroys its content
+ *
+ * @param bufno  FLASH_BUF1 or FLASH_BUF2
+ * @param offset first byte within the buffer
  * @param *buf   buffer containing the data
+ * @param n      number of bytes to write
  */
-void flash_write_page(uint16_t pageno, const uint8_t *buf);
+void flash_buffer_write(uint8_t bufno, uint16_t offset, const uint8_t *buf, uint16_t n);
+
+
+/**
+ * @brief flash_buffer_commit
+ *
+ * @desc program a page with the content of an SRAM buffer
+ * @note the buffer content is kept, so a failed page can be retried elsewhere
+ *
+ * @param bufno  FLASH_BUF1 or FLASH_BUF2
+ * @param pageno specifies the page number, valid values from 0 to flash_num_pages()-1
+ * @param erase  erase the page first. Skipping the erase saves its time and
+ *               energy but requires a page erased before, e.g. by flash_erase_block
+ * @return true if the page verified ok (always true without FLASH_VERIFY),
+ *         false for pages beyond the end of the device
+ */
+bool flash_buffer_commit(uint8_t bufno, uint16_t pageno, bool erase);
+
+
+/**
+ * @brief flash_buffer_program
+ *
+ * @desc like flash_buffer_commit, but the page is never verified.
+ *       Used where every millisecond counts, e.g. on a power fail.
+ *
+ * @param bufno  FLASH_BUF1 or FLASH_BUF2
+ * @param pageno specifies the page number, valid values from 0 to flash_num_pages()-1
+ * @param erase  erase the page first
+ * @return false for pages beyond the end of the device
+ */
+bool flash_buffer_program(uint8_t bufno, uint16_t pageno, bool erase);
+
+
+/**
+ * @brief flash_buffer_verify
+ *
+ * @desc compare a page with the content of an SRAM buffer inside the flash.
+ *       Only the command and the status register are transferred via SPI.
+ *
+ * @param bufno  FLASH_BUF1 or FLASH_BUF2
+ * @param pageno specifies the page number, valid values from 0 to flash_num_pages()-1
+ * @return true if page and buffer are identical
+ */
+bool flash_buffer_verify(uint8_t bufno, uint16_t pageno);
+
+
+/** wake up statistics of the power state manager */
+typedef struct {
+    uint16_t deep_wakes;       /**< resumes from deep power down */
+    uint16_t ultradeep_wakes;  /**< resumes from ultra-deep power down */
+    uint32_t wake_us;          /**< total time spent waiting for wake ups */
+} flash_pm_stats_t;
+
+
+#if(FLASH_FAULT_INJECTION)
+/**
+ * @brief flash_fault_delay
+ *
+ * @desc if set the next flash_buffer_program is aborted by a reset pulse
+ *       flash_fault_delay*10us after programming started. The value is
+ *       cleared afterwards. Used to emulate a power loss during a commit.
+ * @note flash_buffer_commit verifies the aborted page and its caller may
+ *       retry elsewhere, use flash_buffer_program to emulate a power loss
+ */
+extern uint16_t flash_fault_delay;
+#endif
+
+
+/**
+ * @brief flash_erase_block
+ *
+ * @desc erase the block of FLASH_BLOCK_PAGES pages containing a page and
+ *       wait for completion
+ *
+ * @param pageno any page of the block, valid values from 0 to flash_num_pages()-1
+ */
+void flash_erase_block(uint16_t pageno);
+
+
+/**
+ * @brief flash_erase_block_start
+ *
+ * @desc start erasing a block and return without waiting. Until the erase
+ *       has completed, reads and buffer writes suspend it for the access
+ *       and resume it afterwards, so they wait some 10us instead of the
+ *       whole erase. Programming and further erases wait for completion.
+ *
+ * @param pageno any page of the block, valid values from 0 to flash_num_pages()-1
+ */
+void flash_erase_block_start(uint16_t pageno);
+
+
+/**
+ * @brief flash_busy
+ *
+ * @desc return true while an erase started by flash_erase_block_start runs
+ */
+bool flash_busy(void);
+
+
+/**
+ * @brief flash_erase_suspends
+ *
+ * @desc return the number of times a background erase was suspended
+ */
+uint16_t flash_erase_suspends(void);
 
 
 /**
  * @brief flash_erase_chip
  *
  * @desc erases the entire flash content
- * @note this requires 45-80sec!
+ * @note this requires 45-80sec! The device can't suspend a chip erase,
+ *       so this function blocks for the whole time.
  * 
  */
 void flash_erase_chip(void);
 
 
+/**
+ * @brief flash_sleep
+ *
+ * @desc power down the flash until its next access. Ultra-deep power down
+ *       is used if the expected idle time is at least FLASH_ULTRADEEP_MIN_MS
+ *       and the buffers hold no unprogrammed data, deep power down otherwise.
+ * @note every access function wakes the device up automatically
+ *
+ * @param idle_ms  expected time until the next access
+ */
+void flash_sleep(uint16_t idle_ms);
+
+
+/**
+ * @brief flash_buffer_dirty
+ *
+ * @desc return true if a buffer holds data written with flash_buffer_write
+ *       that has not been committed yet
+ */
+bool flash_buffer_dirty(void);
+
+
+/**
+ * @brief flash_get_pm_stats
+ *
+ * @desc return the wake up statistics of the power state manager
+ *
+ * @param *stats  filled with the statistics
+ */
+void flash_get_pm_stats(flash_pm_stats_t *stats);
+
+
 /**
  * @brief flash_enter_deep_powerdown
  *
@@ -119,6 +388,7 @@ void flash_resume_deep_powerdown(void);
  *
  * @desc enter the ultradeep power down mode
  * @note device only reacts to @flash_resume_ultradeep_powerdown
+ * @note the content of both SRAM buffers is lost
  */
 void flash_enter_ultradeep_powerdown(void);
 
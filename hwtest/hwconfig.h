@@ -30,4 +30,8 @@
 #define FLASH_NWP    PB1
 #define FLASH_NCS    PB2
 
+/* SPI0/SPI1 connectors: Rev 1.0 routes their nCS lines to ADC6/ADC7,
+   which are analog inputs only. A sensor there needs its chip select
+   wired to a free port pin to get an spi_device_t. */
+
 #endif
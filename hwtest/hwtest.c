@@ -22,9 +22,20 @@
 #include "i2cmaster.h"
 #include "spi_master.h"
 
+#include "benchmark.h"
+#include "bh1750.h"
+#include "clock.h"
 #include "flash.h"
+#include "logstore.h"
+#include "logdump.h"
+#include "power.h"
 #include "rv8523.h"
+#include "ringbuf.h"
 #include "rv8523_regs.h"
+#include "sampler.h"
+#include "sensor.h"
+#include "sketch.h"
+#include "warmboot.h"
 
 #include "hwconfig.h"
 
@@ -35,12 +46,39 @@
 
 #define UART_OUTPUT(x)   x    // define this to x to get output, otherwise to nothing
 
+#define BENCH_MODE                 0    // 1: print performance numbers instead of running the testcases
+
 #define TEST_LED                   1
 #define TEST_UART                  1
 #define TEST_RTC                   1
 #define TEST_RTC_IRQ               1
 #define TEST_FLASH                 1
+#define TEST_ERASE_SUSPEND         1
 #define TEST_PUSHBUTTON_IRQ        1
+#define TEST_LOG_RECOVERY          0    // erases the flash!
+#define TEST_LOG_QUERY             0
+#define TEST_LOG_SHELL             0
+#define TEST_CLOCK_SCALING         1
+#define TEST_KERNEL_BENCH          1
+#define TEST_SENSORS               1
+#define TEST_SAMPLER               0    // appends to the log
+#define TEST_SKETCH                1
+#define TEST_POWER                 1
+#define TEST_POWER_FAIL            0    // appends to the log
+#define TEST_WARM_BOOT             0    // resets the board after every pass
+
+#if(TEST_LOG_RECOVERY) && !(FLASH_FAULT_INJECTION)
+#error "TEST_LOG_RECOVERY requires FLASH_FAULT_INJECTION=1"
+#endif
+
+#if(TEST_POWER_FAIL) && !(POWER_FAULT_INJECTION)
+#error "TEST_POWER_FAIL requires POWER_FAULT_INJECTION=1"
+#endif
+
+/* timer1 runs with F_CPU/64 for time measurements */
+#define TIMER1_START       (TCNT1 = 0, TCCR1B = _BV(CS11) | _BV(CS10))
+#define TIMER1_STOP        (TCCR1B = 0)
+#define TIMER1_US(ticks)   ((uint32_t)(ticks) * 64000UL / (F_CPU/1000))
 
 /* =================================================================
    Deklarationen
@@ -50,8 +88,23 @@ static int uart_putchar(char c, FILE *stream);
 static int uart_getchar(FILE *stream);
 static FILE mystdout = FDEV_SETUP_STREAM(uart_putchar, uart_getchar, _FDEV_SETUP_RW);
 
-static volatile uint8_t rtcint_counter = 0;
-static volatile uint8_t buttonint_counter = 0;
+/* events handed from the ISRs to the main loop */
+enum {EVENT_RTC=1, EVENT_BUTTON};
+
+typedef struct {
+    uint8_t  source;  /**< EVENT_RTC or EVENT_BUTTON */
+    uint8_t  pins;    /**< PIND when the interrupt fired */
+    uint16_t tick;    /**< TCNT1 when the interrupt fired */
+} event_t;
+
+RINGBUF_DEFINE(eventq, event_t, 8)
+
+static eventq_t events;
+
+#if(TEST_LOG_RECOVERY)
+/* crash points in 10us after the start of a page commit, 0=no crash */
+static const uint16_t crash_points[] PROGMEM = {0, 1, 50, 100, 200, 400, 800, 1600, 3200};
+#endif
 
 
 /* =================================================================
@@ -62,16 +115,21 @@ static volatile uint8_t buttonint_counter = 0;
 // ISR für Pushbutton -> ATMEGA328P PD6 = PCINT22
 ISR(PCINT2_vect)
 {
+    static uint8_t last = 0xff;
+    uint16_t tick = TCNT1;
+    uint8_t pins = PIND;
+    uint8_t fell = last & ~pins;
 
-    /* handler for RTC wakeup interrupt */
-    if(!(PIND & _BV(RTCINT1))){ // triggered by the RTC
+    last = pins;
+
+    /* handler for RTC wakeup interrupt. Only the falling edge counts, the
+       end of the pulse interrupts once more and is ignored here. */
+    if(fell & _BV(RTCINT1)){ // triggered by the RTC
         PORTD |= _BV(LED_STATE);
         rv8523_clearAlarmFlag();
         rv8523_setAlarmMinute(false, 0, true);
-        ++rtcint_counter;
-        // wait until IRQ line is back up!
-        while(!(PIND & _BV(RTCINT1)))
-            ;
+        event_t ev = {EVENT_RTC, pins, tick};
+        eventq_push(&events, &ev);
         PORTD &= ~_BV(LED_STATE);
     }
 
@@ -81,7 +139,8 @@ ISR(PCINT2_vect)
             _delay_ms(10);
         }while(!(PIND & _BV(BUTTON)));
         _delay_ms(10);
-        ++buttonint_counter;
+        event_t ev = {EVENT_BUTTON, PIND, tick};
+        eventq_push(&events, &ev);
     }
 }
 
@@ -120,6 +179,64 @@ static void ioinit(void)
 }
 
 
+/* drop all events queued so far */
+static void flush_events(void)
+{
+    event_t batch[4];
+    while(eventq_pop_batch(&events, batch, 4))
+        ;
+}
+
+/* drain the event queue in batches until an event of source arrived */
+static void wait_event(uint8_t source)
+{
+    event_t batch[4];
+    uint8_t i, n;
+
+    for(;;){
+        n = eventq_pop_batch(&events, batch, 4);
+        for(i=0; i<n; ++i)
+            if(batch[i].source == source)
+                return;
+    }
+}
+
+#if(BENCH_MODE)
+/* time from the wake-up to the main program running again. The ISR takes
+   TCNT1 first thing, the main program right after sleep_cpu(). The cpu
+   sleeps in idle mode, so timer1 keeps running. The ISR does not wait for
+   the end of the RTC pulse, the RTC acknowledge is part of the result.
+   From the edge to the ISR it is a fixed 4 cycles wake-up plus the
+   interrupt response. */
+static void bench_wake_latency(void)
+{
+    event_t ev;
+    uint16_t ticks, woke;
+
+    TCCR1A = 0;
+    TCCR1B = _BV(CS11) | _BV(CS10);   // free running with F_CPU/64
+    flush_events();
+    rv8523_setTimerA(1);
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sei();
+    for(;;){
+        sleep_enable();
+        sleep_cpu();
+        woke = TCNT1;
+        sleep_disable();
+        if(eventq_pop(&events, &ev) && ev.source == EVENT_RTC)
+            break;
+    }
+    ticks = woke - ev.tick;
+    cli();
+    TIMER1_STOP;
+    rv8523_setTimerA(0);
+    rv8523_clearTimerFlag();
+    printf_P(PSTR("            rtc irq wake   %7luus\n"), TIMER1_US(ticks));
+}
+#endif
+
+
 static int uart_putchar(char c, FILE *stream)
 {
     if (c == '\n') uart_putchar('\r', stream);
@@ -160,16 +277,19 @@ int main (void)
     uint8_t hour = 0x23;
     uint8_t min = 0x50;
     uint8_t sec = 0x00;
-    uint8_t buffer[512];
+    uint8_t buffer[FLASH_PAGE_SIZE_MAX];
+    bool warm = warm_boot();   // before anything touches the state in .noinit
 
     ioinit();
     i2c_init();
     spi_masterInit();
     
-    // set time once
+    // set time once, a warm boot keeps the RTC running as it is
 #if(1)
-    rv8523_coldInit();
-    rv8523_setDateTime24(year, month, day, weekday, hour, min, sec, true);
+    if(!warm){
+        rv8523_coldInit();
+        rv8523_setDateTime24(year, month, day, weekday, hour, min, sec, true);
+    }
 #else
     rv8523_init();
 #endif
@@ -191,8 +311,36 @@ int main (void)
 
     printf_P(PSTR("\n\n*Datenlogger Rev 1.0 Board HW test\n"));
 
+    if(warm){
+        flash_attach();   // the log state is kept, no log_recover required
+        printf_P(PSTR("warm boot (MCUSR %02x), logger state kept\n"), warm_reset_flags());
+    }
+#if(TEST_WARM_BOOT)
+    printf_P(PSTR("Testcase 20: warm boot after the watchdog reset of the last pass. "));
+    if(!(warm_reset_flags() & _BV(WDRF)))
+        printf_P(PSTR("cold boot, skipped\n"));
+    else if(warm)
+        printf_P(PSTR("ok\n"));
+    else{
+        printf_P(PSTR("FAIL\n"));
+        ++errors;
+    }
+#endif
+
     while(1){
 
+#if(BENCH_MODE)
+        printf_P(PSTR("Benchmark: throughput and latency of the board.\n"));
+        log_commit(LOG_RAW);     // bench_run_hw uses flash buffer 1
+        log_commit(LOG_SUMMARY);
+        flash_init();
+        bench_run_hw();
+        bench_wake_latency();
+        bench_run_kernels();
+        _delay_ms(5000);
+        continue;
+#endif
+
 #if(TEST_LED)
         printf_P(PSTR("Testcase 1: observe LED test pattern on board!\n"));
         for(i=0; i<3; ++i){
@@ -243,10 +391,9 @@ int main (void)
                 printf("aarrgg - low again!\n");
             }
 
-            rtcint_counter = 0;
+            flush_events();
             sei(); // is that required?
-            while(rtcint_counter==0)
-                ;
+            wait_event(EVENT_RTC);
             cli();
             printf_P(PSTR("Passed\n"));
         }
@@ -256,46 +403,42 @@ int main (void)
         printf_P(PSTR("Testcase 5: read ID of Flash device. "));
         uint8_t buf[5];
         uint8_t buf2[2];
-            
-        //flash_init();  // trigger a reset to start with
+
+        /* the testcases below use flash buffer 1, it holds the open page
+           of LOG_RAW after a warm boot */
+        log_commit(LOG_RAW);
+        log_commit(LOG_SUMMARY);
+        flash_init();  // trigger a reset to start with and detect the page size
         // spi_masterInit();
         flash_get_id(buf);
         flash_get_status(buf2);
         printf_P(PSTR("ID(%02x %02x %02x %02x %02x) STATUS(%02x %02x). "), buf[0], buf[1], buf[2], buf[3], buf[4], buf2[0], buf2[1]);
-        if((buf[0]==0x1f)
-           && (buf[1]==0x27)
-           && (buf[2]==0x01))
+        if(flash_num_pages())   // device found in the geometry table
             printf_P(PSTR("ok\n"));
         else{
             printf_P(PSTR("FAIL\n"));
             ++errors;
         }
-        if(buf2[0] & 0x1){
-            printf_P(PSTR("            flash configured with 512bytes/sector\n"));
-        }else{
-            printf_P(PSTR("            flash configured with 528bytes/sector\n"));
-            printf_P(PSTR("            ->we'll fix that for you. "));
-            flash_conf_power2_size();
-            flash_get_status(buf2);
-            if(buf2[0]&0x01){
-                printf_P(PSTR("ok\n"));
-            }else{
-                printf_P(PSTR("FAIL\n"));
-                ++errors;
-            }     
-        }
+        printf_P(PSTR("            flash configured with %u pages of %ubytes\n"), flash_num_pages(), flash_page_size());
 
-        printf_P(PSTR("Testcase 6: write page to flash.\n"));
-        int i=8000;
+        printf_P(PSTR("Testcase 6: write page to flash. "));
+        int i=log_scratch_page();   // outside of the log streams
         buffer[0] = (i >>8) & 0xff;
         buffer[1] = i & 0xff;
-        flash_write_page(i, buffer);
-        flash_enter_ultradeep_powerdown();
+        if(flash_write_page(i, buffer))
+            printf_P(PSTR("ok\n"));
+        else{
+            printf_P(PSTR("FAIL\n"));
+            ++errors;
+        }
+        flash_sleep(1000);    // ultra-deep power down, woken up by the next access
         _delay_ms(1000);
-        flash_resume_ultradeep_powerdown();        
 
         printf_P(PSTR("Testcase 7: read page from flash. "));
-        flash_read_page(buffer, 8000);
+        flash_read_page(buffer, i);
+        flash_pm_stats_t pm;
+        flash_get_pm_stats(&pm);
+        printf_P(PSTR("(wakes %u/%u, %luus) "), pm.deep_wakes, pm.ultradeep_wakes, pm.wake_us);
         if((buffer[0] == ((i >>8) & 0xff)) &&
            (buffer[1] == (i & 0xff))){
             printf_P(PSTR("ok\n"));            
@@ -303,6 +446,24 @@ int main (void)
             printf_P(PSTR("FAIL\n"));
             ++errors;
         }
+
+#if(TEST_ERASE_SUSPEND)
+        printf_P(PSTR("Testcase 18: read during a background block erase. "));
+        flash_erase_block_start(i);   // the block of the page written above
+        TIMER1_START;
+        flash_read(0, 0, buffer, 16);
+        TIMER1_STOP;
+        printf_P(PSTR("(read %luus, %u suspends) "), TIMER1_US(TCNT1), flash_erase_suspends());
+        while(flash_busy())
+            ;
+        flash_read(i, 0, buffer, 2);
+        if(buffer[0] == 0xff && buffer[1] == 0xff)
+            printf_P(PSTR("ok\n"));
+        else{
+            printf_P(PSTR("FAIL\n"));
+            ++errors;
+        }
+#endif
 #endif
 
 #if(TEST_PUSHBUTTON_IRQ)        
@@ -311,16 +472,289 @@ int main (void)
             printf_P(PSTR("Failed\n*** Error: pin not pulled high!\n"));
             ++errors;
         }else{
-            buttonint_counter = 0;
+            flush_events();
             sei();
-            while(!buttonint_counter)
-                ;
+            wait_event(EVENT_BUTTON);
             cli();
             printf_P(PSTR("Passed\n"));        
         }
 #endif
 
+#if(TEST_LOG_RECOVERY)
+        printf_P(PSTR("Testcase 9: crash-injection on log commit, formatting flash. "));
+        log_format();
+        printf_P(PSTR("ok\n"));
+        for(i=0; i<sizeof(crash_points)/sizeof(crash_points[0]); ++i){
+            log_recovery_t rec;
+            uint16_t head = log_head(LOG_RAW);
+            uint16_t delay = pgm_read_word(&crash_points[i]);
+            uint32_t now = rv8523_getTimestamp();
+            uint8_t nrec;
+
+            for(nrec=0; nrec<10; ++nrec){
+                memset(buffer, nrec, 32);
+                log_append(LOG_RAW, now, buffer, 32);
+            }
+            /* a power loss leaves no time for verify and retry, log_flush
+               programs the open page just like the power fail handler */
+            flash_fault_delay = delay;
+            log_flush();
+
+            TIMER1_START;
+            log_recover(&rec);
+            TIMER1_STOP;
+            /* a commit aborted early may leave an erased page behind */
+            printf_P(PSTR("            crash@%5uus: recovery %5luus, %2u probes, head %4u, torn %u, %2u records lost. "),
+                     delay*10, TIMER1_US(TCNT1), rec.probes, rec.head, rec.torn,
+                     (rec.head == head) ? nrec : 0);
+            if((rec.head == head+1) || (delay && (rec.head == head)))
+                printf_P(PSTR("ok\n"));
+            else{
+                printf_P(PSTR("FAIL\n"));
+                ++errors;
+            }
+        }
+
+        /* the page at the head needs an erase after recovery, the pages
+           behind it are erased and programmed without erase */
+        printf_P(PSTR("Testcase 12: log commit latency.\n"));
+        for(i=0; i<9; ++i){
+            uint8_t nrec;
+            for(nrec=0; nrec<10; ++nrec){
+                memset(buffer, nrec, 32);
+                log_append(LOG_RAW, rv8523_getTimestamp(), buffer, 32);
+            }
+            TIMER1_START;
+            log_commit(LOG_RAW);
+            TIMER1_STOP;
+            printf_P(PSTR("            page %4u %s erase: %5luus\n"), log_head(LOG_RAW)-1,
+                     i ? "without" : "with   ", TIMER1_US(TCNT1));
+        }
+
+        /* wrap the ring with one page per wake like the sampler: a block
+           erase left running by log_commit means it reclaimed itself */
+        printf_P(PSTR("Testcase 22: erase ahead of the head by log_maintain. "));
+        {
+            uint16_t n, k, p, maintained = 0, late = 0, dirty = 0;
+
+            memset(buffer, 0x22, 32);
+            for(n=0; n<flash_num_pages() + LOG_PREERASE_PAGES; ++n){
+                log_append(LOG_RAW, rv8523_getTimestamp(), buffer, 32);
+                log_commit(LOG_RAW);
+                if(flash_busy())
+                    ++late;
+                if(log_maintain())
+                    ++maintained;
+                while(flash_busy())
+                    ;
+                for(k=0, p=log_head(LOG_RAW); k<LOG_PREERASE_PAGES; ++k, p=log_next(LOG_RAW, p)){
+                    log_page_hdr_t hdr;
+                    log_read_header(p, &hdr);
+                    if(hdr.magic != 0xff || hdr.commit != 0xff){
+                        ++dirty;
+                        break;
+                    }
+                }
+            }
+            printf_P(PSTR("(%u pages, %u reclaims, %u by log_commit, %u heads not erased) "), n, maintained, late, dirty);
+            if(maintained && !late && !dirty)
+                printf_P(PSTR("ok\n"));
+            else{
+                printf_P(PSTR("FAIL\n"));
+                ++errors;
+            }
+        }
+#endif
+
+#if(TEST_LOG_QUERY)
+        printf_P(PSTR("Testcase 10: time-range query of the last hour.\n"));
+        {
+            uint32_t now = rv8523_getTimestamp();
+            uint16_t first;
+
+            log_recover(NULL);
+            TIMER1_START;
+            first = log_find(LOG_RAW, now - 3600);
+            TIMER1_STOP;
+            printf_P(PSTR("            page %u of %u found in %luus.\n"), first, log_head(LOG_RAW), TIMER1_US(TCNT1));
+            printf_P(PSTR("            %u pages sent\n"), logdump_range(now - 3600, now));
+        }
+#endif
+
+#if(TEST_LOG_SHELL)
+        printf_P(PSTR("Testcase 11: log download, commands N, A <seq>, R <from> <to>, Q, I, anything else quits.\n"));
+        log_recover(NULL);
+        printf_P(PSTR("            sync cursor %lu, head %u\n"), log_sync_cursor(), log_head(LOG_RAW));
+        while(logdump_command())
+            ;
+#endif
+
+#if(TEST_CLOCK_SCALING)
+        /* multiply with the supply current measured at each clock to get the energy */
+        printf_P(PSTR("Testcase 13: active time of a wake cycle (RTC read + 64 flash bytes).\n"));
+        for(i=0; i<=2; i+=2){
+            uint32_t us;
+            if(!clock_set_div(i)){
+                printf_P(PSTR("            F_CPU/%u: FAIL\n"), 1<<i);
+                ++errors;
+                continue;
+            }
+            TIMER1_START;
+            rv8523_getTimestamp();
+            flash_read(0, 0, buffer, 64);
+            TIMER1_STOP;
+            us = TIMER1_US(TCNT1) << i;   // timer1 runs from the scaled clock
+            clock_set_div(0);
+            printf_P(PSTR("            F_CPU/%u: %luus\n"), 1<<i, us);
+        }
+#endif
+
+#if(TEST_KERNEL_BENCH)
+        printf_P(PSTR("Testcase 14: kernel benchmark against the reference cycle counts.\n"));
+        log_recover(NULL);    // log_find works on the current log
+        errors += bench_run_kernels();
+#endif
+
+#if(TEST_SENSORS)
+        printf_P(PSTR("Testcase 15: sample the sensors on the I2C connectors.\n"));
+        printf_P(PSTR("            %u sensors found\n"), sensor_probe_all());
+        sensor_sample_all();
+        for(i=0; i<SENSOR_MAX; ++i){
+            const sensor_reading_t *r = sensor_get(i);
+            if(!sensor_present(i))
+                continue;
+            printf_P(PSTR("            %-10S latency %6luus bus %5uus "), sensor_name(i), r->latency_us, r->bus_us);
+            if(r->len){
+                printf_P(PSTR("OK\n"));
+            }else{
+                printf_P(PSTR("FAIL\n"));
+                ++errors;
+            }
+        }
+        if(sensor_present(0))    // bh1750
+            printf_P(PSTR("            light %lumlx after %u conversions\n"),
+                     bh1750_millilux(sensor_get(0)->data), bh1750_conversions());
+        sensor_powerdown_all();
+#endif
+
+#if(TEST_SAMPLER)
+        /* one synthetic day: dark night, one hour dawn ramp to 20klx, flat day */
+        printf_P(PSTR("Testcase 16: adaptive sampling of a synthetic day. "));
+        {
+            uint32_t t0 = rv8523_toTimestamp(21, 6, 21, 0, 0, 0);
+            uint32_t t, value;
+            uint16_t taken, saved;
+
+            log_recover(NULL);
+            sampler_init();
+            for(t=t0; t<t0+86400UL; t+=sampler_interval()){
+                if(t < t0 + 6*3600UL)
+                    value = 0;
+                else if(t < t0 + 7*3600UL)
+                    value = (t - t0 - 6*3600UL) * 5555UL;
+                else
+                    value = 20000000UL;
+                sampler_sample(t, value);
+            }
+            sampler_today(&taken, &saved);
+            sampler_sample(t, value);    // the next day logs the counters and summaries
+            log_commit(LOG_RAW);
+            rv8523_setTimerA(0);
+            printf_P(PSTR("%u taken, %u saved (fixed rate %u), %u summary pages. "), taken, saved,
+                     (uint16_t)(86400UL/SAMPLER_MIN_S), log_head(LOG_SUMMARY) - log_tail(LOG_SUMMARY));
+            if(taken < 86400UL/SAMPLER_MIN_S/4 && log_head(LOG_SUMMARY) != log_tail(LOG_SUMMARY))
+                printf_P(PSTR("ok\n"));
+            else{
+                printf_P(PSTR("FAIL\n"));
+                ++errors;
+            }
+        }
+#endif
+
+#if(TEST_SKETCH)
+        /* the values k*k*13+1, k=1..1000 in scrambled order have known quantiles.
+           The bin mapping is checked with recorded samples by "make sketchtest". */
+        printf_P(PSTR("Testcase 17: quantile sketch against exact quantiles.\n"));
+        {
+            static const uint8_t percents[] PROGMEM = {5, 25, 50, 75, 95};
+            uint32_t exact, est, err;
+            uint16_t k;
+            uint8_t p;
+
+            sketch_reset();
+            for(k=0; k<1000; ++k){
+                uint32_t v = (k * 389UL) % 1000 + 1;
+                sketch_add(v*v*13 + 1, 1);
+            }
+            for(i=0; i<sizeof(percents); ++i){
+                p = pgm_read_byte(&percents[i]);
+                k = 1000U * p / 100 + 1;
+                exact = (uint32_t)k*k*13 + 1;
+                TIMER1_START;
+                est = sketch_quantile(p);
+                TIMER1_STOP;
+                err = (est > exact ? est - exact : exact - est) * 1000 / exact;
+                printf_P(PSTR("            p%-2u exact %8lu sketch %8lu error %2lu.%lu%% in %4luus "),
+                         p, exact, est, err/10, err%10, TIMER1_US(TCNT1));
+                if(err <= 125)
+                    printf_P(PSTR("ok\n"));
+                else{
+                    printf_P(PSTR("FAIL\n"));
+                    ++errors;
+                }
+            }
+            sketch_reset();
+        }
+#endif
+
+#if(TEST_POWER)
+        printf_P(PSTR("Testcase 19: supply voltage via the bandgap. "));
+        uint16_t vcc = power_vcc_mv();
+        printf_P(PSTR("(VCC %umV, warning below %umV) "), vcc, POWER_WARN_MV);
+        if(vcc >= POWER_WARN_MV && vcc < 5500)
+            printf_P(PSTR("ok\n"));
+        else{
+            printf_P(PSTR("FAIL\n"));
+            ++errors;
+        }
+#endif
+
+#if(TEST_POWER_FAIL)
+        /* a faked supply drop during sampling has to commit the open page */
+        printf_P(PSTR("Testcase 21: power fail from the sampling path. "));
+        {
+            uint32_t now = rv8523_getTimestamp();
+            uint16_t head;
+            log_end_t end;
+
+            log_recover(NULL);
+            sampler_init();
+            head = log_head(LOG_RAW);
+            memset(buffer, 0x21, 32);
+            log_append(LOG_RAW, now, buffer, 32);
+            power_fault_mv = POWER_WARN_MV - 100;
+            sampler_sample(now, 0);
+            rv8523_setTimerA(0);
+            printf_P(PSTR("(head %u -> %u) "), head, log_head(LOG_RAW));
+            log_recover(NULL);    // the committed page has to survive a reboot
+            if(log_head(LOG_RAW) == log_next(LOG_RAW, head) &&
+               log_newest(LOG_RAW, &end) && end.page == head)
+                printf_P(PSTR("ok\n"));
+            else{
+                printf_P(PSTR("FAIL\n"));
+                ++errors;
+            }
+        }
+#endif
+
         UART_OUTPUT(printf_P(PSTR("\n*****************Summary %d errors ******************\n\n"), errors));
+
+        warm_seal();
+#if(TEST_WARM_BOOT)
+        wdt_enable(WDTO_15MS);   // warm boot into the next pass
+        for(;;)
+            ;
+#endif
     }
 
     return (0);
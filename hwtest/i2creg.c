@@ -0,0 +1,94 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file i2creg.c
+ * Register and command access to I2C devices on top of i2cmaster
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "i2cmaster.h"
+#include "i2creg.h"
+
+
+/*
+ * local functions
+ */
+
+/* read n bytes after a (repeated) start, the last one is not acknowledged */
+static void read_bytes(uint8_t *buf, uint8_t n)
+{
+    for(; n>1; --n, ++buf)
+        *buf = i2c_readAck();
+    *buf = i2c_readNak();
+}
+
+
+/*
+ * global functions
+ */
+
+bool i2c_probe(uint8_t dev)
+{
+    bool ack = (i2c_start(dev+I2C_WRITE) == 0);
+    i2c_stop();
+    return ack;
+}
+
+
+bool i2c_read_regs(uint8_t dev, uint8_t regno, uint8_t n, uint8_t *buf)
+{
+    if(i2c_start(dev+I2C_WRITE)){
+        i2c_stop();
+        return false;
+    }
+    i2c_write(regno);
+    i2c_rep_start(dev+I2C_READ);
+    read_bytes(buf, n);
+    i2c_stop();
+    return true;
+}
+
+
+bool i2c_write_regs(uint8_t dev, uint8_t regno, uint8_t n, const uint8_t *buf)
+{
+    if(i2c_start(dev+I2C_WRITE)){
+        i2c_stop();
+        return false;
+    }
+    i2c_write(regno);
+    for(; n>0; --n, ++buf)
+        i2c_write(*buf);
+    i2c_stop();
+    return true;
+}
+
+
+bool i2c_send(uint8_t dev, const uint8_t *buf, uint8_t n)
+{
+    if(i2c_start(dev+I2C_WRITE)){
+        i2c_stop();
+        return false;
+    }
+    for(; n>0; --n, ++buf)
+        i2c_write(*buf);
+    i2c_stop();
+    return true;
+}
+
+
+bool i2c_receive(uint8_t dev, uint8_t *buf, uint8_t n)
+{
+    if(i2c_start(dev+I2C_READ)){
+        i2c_stop();
+        return false;
+    }
+    read_bytes(buf, n);
+    i2c_stop();
+    return true;
+}
@@ -0,0 +1,87 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file i2creg.h
+ * Register and command access to I2C devices on top of i2cmaster
+ *
+ * The device address is given as 8 bit address with the R/W bit cleared,
+ * like DEV_RV8523. All functions release the bus with a stop condition
+ * and return false if the device did not acknowledge.
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#ifndef _I2CREG_H_
+#define _I2CREG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/**
+ * @brief i2c_probe
+ *
+ * @desc check if a device acknowledges its address
+ *
+ * @param dev  device address
+ * @return true if the device is present
+ */
+bool i2c_probe(uint8_t dev);
+
+
+/**
+ * @brief i2c_read_regs
+ *
+ * @desc read consecutive registers starting at regno
+ *
+ * @param dev    device address
+ * @param regno  first register
+ * @param n      number of registers, at least 1
+ * @param *buf   filled with the register values
+ * @return false if the device did not answer
+ */
+bool i2c_read_regs(uint8_t dev, uint8_t regno, uint8_t n, uint8_t *buf);
+
+
+/**
+ * @brief i2c_write_regs
+ *
+ * @desc write consecutive registers starting at regno
+ *
+ * @param dev    device address
+ * @param regno  first register
+ * @param n      number of registers
+ * @param *buf   register values
+ * @return false if the device did not answer
+ */
+bool i2c_write_regs(uint8_t dev, uint8_t regno, uint8_t n, const uint8_t *buf);
+
+
+/**
+ * @brief i2c_send
+ *
+ * @desc write raw bytes, for devices driven by commands instead of registers
+ *
+ * @param dev   device address
+ * @param *buf  bytes to send
+ * @param n     number of bytes
+ * @return false if the device did not answer
+ */
+bool i2c_send(uint8_t dev, const uint8_t *buf, uint8_t n);
+
+
+/**
+ * @brief i2c_receive
+ *
+ * @desc read raw bytes without addressing a register first
+ *
+ * @param dev   device address
+ * @param *buf  filled with the received bytes
+ * @param n     number of bytes, at least 1
+ * @return false if the device did not answer
+ */
+bool i2c_receive(uint8_t dev, uint8_t *buf, uint8_t n);
+
+#endif
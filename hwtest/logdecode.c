@@ -0,0 +1,137 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file logdecode.c
+ * Host side decoder of the logdump output, build with 'make logdecode'
+ *
+ * Reads the lines sent by logdump (P, : and E lines) from stdin and prints
+ * one line per record with its fields named as in schema.h. The fields
+ * are read straight from the received page, nothing is unpacked into
+ * structs. Pages of another schema id are printed in hex.
+ *
+ *   logdecode < dump.txt
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "record.h"
+
+#define PAGE_MAX 1056   /**< largest page of the AT45DB family */
+
+/** one field of a layout */
+typedef struct {
+    const char *name;
+    uint16_t pos;
+    uint8_t bits;
+} field_desc_t;
+
+/** one record type */
+typedef struct {
+    uint8_t type;
+    const char *name;
+    const field_desc_t *fields;
+} record_desc_t;
+
+/* field tables of the layouts, generated from the schema */
+#define FIELD_DESC(l, field, bits)  {#field, REC_POS_##l##_##field, bits},
+#define LAYOUT_DESC(l, fields)  static const field_desc_t fields_##l[] = { fields(FIELD_DESC, l) {NULL, 0, 0} };
+SCHEMA_LAYOUTS(LAYOUT_DESC)
+
+#define RECORD_DESC(name, type, l)  {type, #name, fields_##l},
+static const record_desc_t records[] = { SCHEMA_RECORDS(RECORD_DESC) };
+
+#define NUM_RECORDS (sizeof(records)/sizeof(records[0]))
+
+static uint8_t page[PAGE_MAX];
+static unsigned nbytes;
+static unsigned schema;
+static unsigned long seq;
+
+
+/*
+ * local functions
+ */
+
+static const record_desc_t *find_record(uint8_t type)
+{
+    unsigned i;
+    for(i=0; i<NUM_RECORDS; ++i)
+        if(records[i].type == type)
+            return &records[i];
+    return NULL;
+}
+
+static void print_hex(const uint8_t *buf, unsigned n)
+{
+    while(n--)
+        printf("%02x", *buf++);
+}
+
+/* walk the records of the received page: length byte, then the record */
+static void decode_page(void)
+{
+    const record_desc_t *rec;
+    const field_desc_t *f;
+    unsigned pos, len;
+
+    for(pos=0; pos<nbytes; pos+=1+len){
+        len = page[pos];
+        if(len == 0 || pos+1+len > nbytes){
+            printf("%lu: broken record at byte %u\n", seq, pos);
+            return;
+        }
+        printf("%lu ", seq);
+        rec = (schema == SCHEMA_ID) ? find_record(page[pos+1]) : NULL;
+        if(!rec){
+            printf("schema %u raw ", schema);
+            print_hex(&page[pos+1], len);
+            printf("\n");
+            continue;
+        }
+        printf("%s", rec->name);
+        for(f=rec->fields; f->name; ++f)
+            printf(" %s=%lu", f->name, (unsigned long)record_get(&page[pos+1], f->pos, f->bits));
+        printf("\n");
+    }
+}
+
+
+/*
+ * global functions
+ */
+
+int main(void)
+{
+    char line[256];
+    unsigned pageno, nrec, byte, i = 0;
+    unsigned long tbase;
+    int n;
+    char *p;
+
+    while(fgets(line, sizeof(line), stdin)){
+        if(line[0] == 'P'){
+            n = sscanf(line, "P %u %lu %lu %u %u %u", &pageno, &seq, &tbase, &nrec, &nbytes, &schema);
+            if(n < 5)
+                continue;
+            if(n == 5)
+                schema = 0;   // dump of a firmware without schema
+            if(nbytes > PAGE_MAX)
+                nbytes = PAGE_MAX;
+            i = 0;
+        }else if(line[0] == ':'){
+            for(p=line+1; i<nbytes && sscanf(p, "%2x", &byte) == 1; p+=2)
+                page[i++] = byte;
+            if(i == nbytes)
+                decode_page();
+        }else if(line[0] == 'E'){
+            printf("%s", line);
+        }
+    }
+    return 0;
+}
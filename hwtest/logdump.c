@@ -0,0 +1,138 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file logdump.c
+ * Readout of the record log via the UART (stdout)
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+#include "flash.h"
+#include "logstore.h"
+#include "logdump.h"
+
+#define LINE_BYTES 32  /**< payload bytes per output line */
+
+
+/*
+ * local functions
+ */
+
+static void put_hex(uint8_t val)
+{
+    static const char digits[] PROGMEM = "0123456789abcdef";
+    putchar(pgm_read_byte(&digits[val >> 4]));
+    putchar(pgm_read_byte(&digits[val & 0x0f]));
+}
+
+/* stream the payload straight from the flash to the UART */
+static void dump_page(uint16_t pageno, const log_page_hdr_t *hdr)
+{
+    uint16_t pos;
+    uint8_t val;
+
+    printf_P(PSTR("P %u %lu %lu %u %u %u\n"), pageno, hdr->seq, hdr->tbase, hdr->nrec, hdr->nbytes,
+             LOG_PAGE_SCHEMA(hdr));
+    flash_stream_open(pageno, 0);
+    for(pos=0; pos<hdr->nbytes; ++pos){
+        if(pos % LINE_BYTES == 0)
+            putchar(':');
+        flash_stream_read(&val, 1);
+        put_hex(val);
+        if((pos % LINE_BYTES == LINE_BYTES-1) || (pos == hdr->nbytes-1))
+            putchar('\n');
+    }
+    flash_stream_close();
+}
+
+/* send the pages from pageno to the head of a stream up to a timestamp */
+static uint16_t dump_stream(uint8_t stream, uint16_t pageno, uint32_t to)
+{
+    log_page_hdr_t hdr;
+    uint16_t sent = 0;
+
+    for(; pageno!=log_head(stream); pageno=log_next(stream, pageno)){
+        if(!log_read_header(pageno, &hdr))
+            continue;   /* skipped bad page */
+        if(hdr.tbase > to)
+            break;
+        dump_page(pageno, &hdr);
+        ++sent;
+    }
+    printf_P(PSTR("E %u\n"), sent);
+    return sent;
+}
+
+
+/*
+ * global functions
+ */
+
+uint16_t logdump_range(uint32_t from, uint32_t to)
+{
+    return dump_stream(LOG_RAW, log_find(LOG_RAW, from), to);
+}
+
+
+uint16_t logdump_new(void)
+{
+    return dump_stream(LOG_RAW, log_find_seq(LOG_RAW, log_sync_cursor()), 0xffffffff);
+}
+
+
+void logdump_info(void)
+{
+    log_end_t oldest, newest;
+    uint8_t i;
+
+    for(i=0; i<LOG_STREAMS; ++i){
+        if(log_oldest(i, &oldest) && log_newest(i, &newest))
+            printf_P(PSTR("I %u %lu %lu %lu %lu\n"), i, oldest.seq, oldest.tbase, newest.seq, newest.tbase);
+        else
+            printf_P(PSTR("I %u\n"), i);
+    }
+}
+
+
+uint16_t logdump_summary(void)
+{
+    return dump_stream(LOG_SUMMARY, log_tail(LOG_SUMMARY), 0xffffffff);
+}
+
+
+bool logdump_command(void)
+{
+    uint32_t a, b;
+    char cmd;
+
+    if(scanf(" %c", &cmd) != 1)
+        return false;
+    switch(cmd){
+    case 'N':
+        logdump_new();
+        return true;
+    case 'Q':
+        logdump_summary();
+        return true;
+    case 'I':
+        logdump_info();
+        return true;
+    case 'A':
+        if(scanf("%lu", &a) != 1)
+            return false;
+        log_sync_ack(a);
+        return true;
+    case 'R':
+        if(scanf("%lu %lu", &a, &b) != 2)
+            return false;
+        logdump_range(a, b);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,88 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file logdump.h
+ * Readout of the record log via the UART (stdout)
+ *
+ * Every page is sent as a header line followed by its payload in hex:
+ *   P <page> <seq> <tbase> <nrec> <nbytes> <schema>
+ *   :<32 bytes of payload in hex>
+ * A transfer ends with the line
+ *   E <pages sent>
+ * The records in the payload are decoded by logdecode with schema.h.
+ *
+ * Commands understood by logdump_command, one per line:
+ *   N              send all pages not acknowledged yet
+ *   A <seq>        acknowledge all pages up to sequence number seq
+ *   R <from> <to>  send the pages of a time range
+ *   Q              send all summary pages, the quick look at a deployment
+ *   I              send the oldest and newest page of each stream:
+ *                    I <stream> <oldest seq> <oldest tbase> <newest seq> <newest tbase>
+ *                  or I <stream> if the stream is empty
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#ifndef _LOGDUMP_H_
+#define _LOGDUMP_H_
+
+#include <stdbool.h>
+
+
+/**
+ * @brief logdump_range
+ *
+ * @desc send all LOG_RAW pages holding records between two points in time.
+ *       The first page is located with log_find, no sequential scan.
+ *
+ * @param from  first timestamp of interest
+ * @param to    last timestamp of interest
+ * @return number of pages sent
+ */
+uint16_t logdump_range(uint32_t from, uint32_t to);
+
+
+/**
+ * @brief logdump_new
+ *
+ * @desc send all LOG_RAW pages newer than the sync cursor, i.e. the pages the
+ *       host has not acknowledged yet
+ *
+ * @return number of pages sent
+ */
+uint16_t logdump_new(void);
+
+
+/**
+ * @brief logdump_info
+ *
+ * @desc send the sequence numbers and timestamps of both ends of all streams,
+ *       so the host knows the retained range before a transfer.
+ *       Answered from RAM, see log_oldest.
+ */
+void logdump_info(void);
+
+
+/**
+ * @brief logdump_summary
+ *
+ * @desc send all pages of the LOG_SUMMARY stream. These hold the hour and
+ *       day summaries of the whole deployment in a few pages.
+ *
+ * @return number of pages sent
+ */
+uint16_t logdump_summary(void);
+
+
+/**
+ * @brief logdump_command
+ *
+ * @desc read one command from stdin and execute it
+ *
+ * @return false for an unknown command
+ */
+bool logdump_command(void);
+
+#endif
@@ -0,0 +1,628 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file logstore.c
+ * Power-fail-safe record log on top of the Adesto flash
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+
+#include "flash.h"
+#include "logstore.h"
+#include "schema.h"
+#include "spi_master.h"
+#include "warmboot.h"
+
+#define WL_SLOTS 16  /**< eeprom slots used round robin for a growing counter */
+#define WL_EMPTY 0xffffffff
+
+/* the flash refuses its accesses while another device holds the bus, a
+   refused write would look like a bad page, so don't start at all */
+#define LOG_REFUSE_IF_BUSY(...)  do{ if(spi_masterBusy()) return __VA_ARGS__; }while(0)
+
+/** counter that only grows, the slot holding the largest value is current */
+typedef struct {
+    uint32_t val;
+    uint8_t  slot;
+} wl_counter_t;
+
+/** eeprom slot of a counter */
+typedef struct {
+    uint32_t val;
+    uint8_t  check;  /**< crc8 of val, written last, fails for a torn write */
+} wl_slot_t;
+
+/** one stream, the pages of its region are addressed by their index
+    counted from the tail, so a ring wraps without special cases */
+typedef struct {
+    uint16_t first;  /**< first page of the region */
+    uint16_t size;   /**< pages in the region, a multiple of FLASH_BLOCK_PAGES */
+    bool     ring;   /**< the oldest block is reclaimed when the region is full */
+    uint8_t  bufno;  /**< flash SRAM buffer holding the open page */
+    uint16_t tail;   /**< oldest page, start of a block */
+    uint16_t count;  /**< pages from the tail to the write head */
+    uint16_t erased; /**< pages from this index on are known to be erased */
+    uint32_t seq;    /**< sequence number of the open page */
+    uint32_t tbase;  /**< timestamp of the first record in the open page */
+    uint16_t fill;   /**< payload bytes in the open page */
+    uint16_t nrec;   /**< records in the open page */
+    uint16_t crc;    /**< running crc over the payload */
+    log_end_t oldest;
+    log_end_t newest;
+    wl_counter_t reclaimed;  /**< blocks reclaimed since the format */
+} log_stream_t;
+
+static wl_slot_t EEMEM sync_slots[WL_SLOTS];
+static wl_slot_t EEMEM reclaim_slots[LOG_STREAMS][WL_SLOTS];
+
+static struct {
+    log_stream_t streams[LOG_STREAMS];
+    uint16_t bad;            /**< pages skipped as they failed to verify */
+    wl_counter_t sync;       /**< first sequence number not acknowledged by the host */
+} logstate NOINIT;
+
+
+/*
+ * local functions
+ */
+
+static uint16_t crc_update(uint16_t crc, const uint8_t *buf, uint16_t n)
+{
+    for(; n>0; --n)
+        crc = _crc_ccitt_update(crc, *(buf++));
+    return crc;
+}
+
+/* crc over the header fields covered by log_page_hdr_t.crc */
+static uint16_t crc_header(uint16_t crc, const log_page_hdr_t *hdr)
+{
+    return crc_update(crc, (const uint8_t *)hdr, offsetof(log_page_hdr_t, crc));
+}
+
+static void read_header(uint16_t pageno, log_page_hdr_t *hdr)
+{
+    flash_read(pageno, LOG_HDR_OFFSET, (uint8_t *)hdr, sizeof(*hdr));
+}
+
+static bool header_erased(const log_page_hdr_t *hdr)
+{
+    return (hdr->magic == 0xff) && (hdr->commit == 0xff);
+}
+
+static bool header_valid(const log_page_hdr_t *hdr)
+{
+    return (uint8_t)(hdr->magic - LOG_PAGE_MAGIC) <= LOG_SCHEMA_MAX
+        && (hdr->commit == LOG_COMMIT_MARK)
+        && (hdr->nbytes <= LOG_PAYLOAD_SIZE);
+}
+
+/* check a committed page without a page sized RAM buffer */
+static bool page_valid(uint16_t pageno, const log_page_hdr_t *hdr)
+{
+    uint16_t crc = 0xffff;
+    uint16_t n;
+    uint8_t val;
+
+    if(!header_valid(hdr))
+        return false;
+    flash_stream_open(pageno, 0);
+    for(n=hdr->nbytes; n>0; --n){
+        flash_stream_read(&val, 1);
+        crc = _crc_ccitt_update(crc, val);
+    }
+    flash_stream_close();
+    return crc_header(crc, hdr) == hdr->crc;
+}
+
+static uint8_t wl_check(uint32_t val)
+{
+    uint8_t crc = 0;
+    uint8_t i;
+
+    for(i=0; i<4; ++i, val>>=8)
+        crc = _crc8_ccitt_update(crc, (uint8_t)val);
+    return crc;
+}
+
+/* a slot torn by a power loss is skipped, the previous value is kept */
+static void wl_load(wl_slot_t *slots, wl_counter_t *c)
+{
+    uint32_t val;
+    uint8_t i;
+
+    c->val = 0;
+    c->slot = 0;
+    for(i=0; i<WL_SLOTS; ++i){
+        val = eeprom_read_dword(&slots[i].val);
+        if(val != WL_EMPTY && val >= c->val && eeprom_read_byte(&slots[i].check) == wl_check(val)){
+            c->val = val;
+            c->slot = i;
+        }
+    }
+}
+
+static void wl_store(wl_slot_t *slots, wl_counter_t *c, uint32_t val)
+{
+    c->val = val;
+    c->slot = (c->slot+1) % WL_SLOTS;
+    eeprom_update_dword(&slots[c->slot].val, val);
+    eeprom_update_byte(&slots[c->slot].check, wl_check(val));
+}
+
+static void wl_clear(wl_slot_t *slots, wl_counter_t *c)
+{
+    uint8_t i;
+
+    for(i=0; i<WL_SLOTS; ++i){
+        eeprom_update_dword(&slots[i].val, WL_EMPTY);
+        eeprom_update_byte(&slots[i].check, 0xff);
+    }
+    wl_load(slots, c);
+}
+
+/* pages that can hold data, a ring keeps its last block erased */
+static uint16_t capacity(const log_stream_t *s)
+{
+    if(!s->ring)
+        return s->size;
+    return (s->size > FLASH_BLOCK_PAGES) ? s->size - FLASH_BLOCK_PAGES : 0;
+}
+
+/* page of index i, counted from the tail */
+static uint16_t page_at(const log_stream_t *s, uint16_t i)
+{
+    uint16_t p = s->tail + i;
+
+    if(i < s->size && p >= s->first + s->size)
+        p -= s->size;
+    return p;
+}
+
+static void set_tail(log_stream_t *s)
+{
+    s->tail = s->first;
+    if(s->ring && s->size)
+        s->tail += (s->reclaimed.val % (s->size / FLASH_BLOCK_PAGES)) * FLASH_BLOCK_PAGES;
+}
+
+/* a missing or too small device gets empty regions, the log refuses then */
+static bool set_regions(void)
+{
+    uint16_t n = log_scratch_page();   /* the last block is left to the tests */
+    uint16_t nsum = LOG_SUMMARY_PAGES & ~(FLASH_BLOCK_PAGES-1);
+    log_stream_t *s;
+
+    if(flash_num_pages() < LOG_MIN_PAGES || nsum < FLASH_BLOCK_PAGES
+       || n - nsum < 2*FLASH_BLOCK_PAGES)
+        n = nsum = 0;
+
+    s = &logstate.streams[LOG_RAW];
+    s->first = 0;
+    s->size = n - nsum;
+    s->ring = (LOG_RAW_RETENTION == LOG_OVERWRITE);
+    s->bufno = FLASH_BUF1;
+
+    s = &logstate.streams[LOG_SUMMARY];
+    s->first = n - nsum;
+    s->size = nsum;
+    s->ring = (LOG_SUMMARY_RETENTION == LOG_OVERWRITE);
+    s->bufno = FLASH_BUF2;
+    return n != 0;
+}
+
+static void open_page(log_stream_t *s, uint32_t seq)
+{
+    s->seq = seq;
+    s->fill = 0;
+    s->nrec = 0;
+    s->crc = 0xffff;
+}
+
+static void clear_stream(log_stream_t *s)
+{
+    set_tail(s);
+    s->count = 0;
+    s->erased = 0;
+    s->oldest.page = LOG_NO_PAGE;
+    s->newest.page = LOG_NO_PAGE;
+    open_page(s, 0);
+}
+
+/* oldest (or newest) page with a valid header, bad pages are skipped.
+   Usually the first header read is the one. */
+static void find_end(log_stream_t *s, bool newest)
+{
+    log_end_t *end = newest ? &s->newest : &s->oldest;
+    log_page_hdr_t hdr;
+    uint16_t i, n;
+
+    end->page = LOG_NO_PAGE;
+    for(n=0; n<s->count; ++n){
+        i = newest ? s->count-1-n : n;
+        read_header(page_at(s, i), &hdr);
+        if(header_valid(&hdr)){
+            end->page = page_at(s, i);
+            end->seq = hdr.seq;
+            end->tbase = hdr.tbase;
+            return;
+        }
+    }
+}
+
+/* the open page has been written to the head */
+static void advance_head(log_stream_t *s)
+{
+    s->newest.page = page_at(s, s->count);
+    s->newest.seq = s->seq;
+    s->newest.tbase = s->tbase;
+    if(s->oldest.page == LOG_NO_PAGE)
+        s->oldest = s->newest;
+    ++s->count;
+    if(s->erased < s->count)
+        s->erased = s->count;
+}
+
+/* drop the oldest block of a ring. The tail is moved before the erase,
+   log_recover finishes an erase interrupted by a power loss. The erase
+   runs in the background, the next commit waits for it if required. */
+static void reclaim(log_stream_t *s)
+{
+    uint16_t block = s->tail;
+
+    wl_store(reclaim_slots[s - logstate.streams], &s->reclaimed, s->reclaimed.val + 1);
+    set_tail(s);
+    s->count -= FLASH_BLOCK_PAGES;
+    s->erased -= FLASH_BLOCK_PAGES;
+    find_end(s, false);      /* before the erase, no suspend needed */
+    if(s->oldest.page == LOG_NO_PAGE)
+        s->newest = s->oldest;
+    flash_erase_block_start(block);
+}
+
+/* complete the open page with its header */
+static void seal_page(log_stream_t *s)
+{
+    log_page_hdr_t hdr;
+
+    hdr.seq = s->seq;
+    hdr.tbase = s->tbase;
+    hdr.nbytes = s->fill;
+    hdr.nrec = s->nrec;
+    hdr.crc = crc_header(s->crc, &hdr);
+    hdr.magic = LOG_PAGE_MAGIC + SCHEMA_ID;
+    hdr.commit = LOG_COMMIT_MARK;
+    flash_buffer_write(s->bufno, LOG_HDR_OFFSET, (const uint8_t *)&hdr, sizeof(hdr));
+}
+
+static uint8_t recover_stream(log_stream_t *s, bool *torn)
+{
+    log_page_hdr_t hdr;
+    uint16_t lo = 0, hi = capacity(s);
+    uint16_t i;
+    uint8_t probes = 0;
+
+    *torn = false;
+    set_tail(s);
+
+    /* the last block of a ring is erased unless a reclaim was interrupted */
+    for(i=hi; i<s->size; ++i){
+        read_header(page_at(s, i), &hdr);
+        ++probes;
+        if(!header_erased(&hdr)){
+            flash_erase_block(page_at(s, hi));
+            break;
+        }
+    }
+
+    /* counted from the tail the pages [0, head) are written, all pages
+       behind are erased. Only the page at head-1 may be torn by a power
+       loss. Bad pages skipped by log_commit are not erased and count as
+       written. */
+    while(lo < hi){
+        uint16_t mid = lo + (hi-lo)/2;
+        read_header(page_at(s, mid), &hdr);
+        ++probes;
+        if(!header_erased(&hdr))
+            lo = mid+1;
+        else
+            hi = mid;
+    }
+
+    /* continue the sequence behind the last page passing its checks. Bad
+       pages skipped by log_commit carry garbage, at most a block of them
+       precedes the head. */
+    open_page(s, 0);
+    for(i=lo; i>0 && lo-i <= FLASH_BLOCK_PAGES; --i){
+        read_header(page_at(s, i-1), &hdr);
+        ++probes;
+        if(page_valid(page_at(s, i-1), &hdr)){
+            open_page(s, hdr.seq+1);
+            break;
+        }
+    }
+
+    /* the head page itself may hold a torn commit without a header, so may
+       the retry of log_commit following a run of bad pages. It is at most
+       a block behind the last valid page, these pages are erased again. */
+    s->erased = i + FLASH_BLOCK_PAGES + 1;
+    if(s->erased <= lo)
+        s->erased = lo+1;
+
+    /* roll back if the last page has a bad crc, the commit was interrupted */
+    if(lo > 0 && i != lo){
+        *torn = true;
+        --lo;
+    }
+    s->count = lo;
+    find_end(s, false);
+    find_end(s, true);
+    return probes;
+}
+
+/* first index in [0, count) whose seq (or tbase) is larger than key */
+static uint16_t search_after(const log_stream_t *s, bool by_seq, uint32_t key)
+{
+    log_page_hdr_t hdr;
+    uint16_t lo = 0, hi = s->count;
+    uint16_t mid, i;
+
+    while(lo < hi){
+        mid = lo + (hi-lo)/2;
+        /* skip pages dropped by log_commit, their header is garbage */
+        for(i=mid; i<hi && !log_read_header(page_at(s, i), &hdr); ++i)
+            ;
+        if(i == hi)
+            hi = mid;
+        else if((by_seq ? hdr.seq : hdr.tbase) <= key)
+            lo = i+1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+
+/*
+ * global functions
+ */
+
+void log_format(void)
+{
+    uint8_t i;
+
+    LOG_REFUSE_IF_BUSY();
+    flash_erase_chip();
+    wl_clear(sync_slots, &logstate.sync);
+    set_regions();
+    for(i=0; i<LOG_STREAMS; ++i){
+        wl_clear(reclaim_slots[i], &logstate.streams[i].reclaimed);
+        clear_stream(&logstate.streams[i]);
+    }
+}
+
+
+bool log_recover(log_recovery_t *info)
+{
+    log_stream_t *s = &logstate.streams[LOG_RAW];
+    uint8_t probes, i;
+    bool torn;
+
+    LOG_REFUSE_IF_BUSY(false);
+    wl_load(sync_slots, &logstate.sync);
+    for(i=0; i<LOG_STREAMS; ++i)
+        wl_load(reclaim_slots[i], &logstate.streams[i].reclaimed);
+    if(!set_regions()){
+        for(i=0; i<LOG_STREAMS; ++i)
+            clear_stream(&logstate.streams[i]);
+        return false;
+    }
+    recover_stream(&logstate.streams[LOG_SUMMARY], &torn);
+    probes = recover_stream(s, &torn);
+
+    if(info){
+        info->head = page_at(s, s->count);
+        info->probes = probes;
+        info->torn = torn;
+    }
+    return true;
+}
+
+
+bool log_append(uint8_t stream, uint32_t ts, const uint8_t *rec, uint8_t len)
+{
+    log_stream_t *s = &logstate.streams[stream];
+
+    LOG_REFUSE_IF_BUSY(false);
+    if((len == 0) || (len >= LOG_PAYLOAD_SIZE) || capacity(s) == 0)
+        return false;
+    if(s->fill + 1 + len > LOG_PAYLOAD_SIZE)
+        log_commit(stream);
+    if(s->fill + 1 + len > LOG_PAYLOAD_SIZE)
+        return false;     /* the stream is full */
+
+    if(s->fill == 0)
+        s->tbase = ts;
+    flash_buffer_write(s->bufno, s->fill, &len, 1);
+    flash_buffer_write(s->bufno, s->fill+1, rec, len);
+    s->crc = _crc_ccitt_update(s->crc, len);
+    s->crc = crc_update(s->crc, rec, len);
+    s->fill += 1 + len;
+    ++s->nrec;
+    return true;
+}
+
+
+uint8_t log_commit(uint8_t stream)
+{
+    log_stream_t *s = &logstate.streams[stream];
+    uint8_t tries;
+
+    LOG_REFUSE_IF_BUSY(LOG_BUSY);
+    if(s->fill == 0)
+        return LOG_COMMITTED;
+    if(s->ring && s->count >= capacity(s) && s->count >= FLASH_BLOCK_PAGES)
+        reclaim(s);
+    seal_page(s);
+
+    /* the buffer survives a failed compare, retry on the following pages.
+       A failure lasting for a whole block is not a bad page, give up. */
+    for(tries=0; tries<FLASH_BLOCK_PAGES; ++tries){
+        if(s->count >= capacity(s))
+            return LOG_FULL;
+        if(flash_buffer_commit(s->bufno, page_at(s, s->count), s->count < s->erased)){
+            advance_head(s);
+            open_page(s, s->seq+1);
+            return LOG_COMMITTED;
+        }
+        ++s->count;
+        if(s->erased < s->count)
+            s->erased = s->count;
+        ++logstate.bad;
+    }
+    return LOG_FAILED;
+}
+
+
+void log_flush(void)
+{
+    uint8_t i;
+
+    LOG_REFUSE_IF_BUSY();
+    for(i=0; i<LOG_STREAMS; ++i){
+        log_stream_t *s = &logstate.streams[i];
+
+        /* no reclaim, a full stream keeps its open page in the buffer */
+        if(s->fill == 0 || s->count >= capacity(s))
+            continue;
+        seal_page(s);
+        flash_buffer_program(s->bufno, page_at(s, s->count), s->count < s->erased);
+        advance_head(s);
+        open_page(s, s->seq+1);
+    }
+}
+
+
+bool log_maintain(void)
+{
+    uint8_t i;
+
+    LOG_REFUSE_IF_BUSY(false);
+    /* reclaiming ahead of time keeps the block erase out of log_commit */
+    for(i=0; i<LOG_STREAMS; ++i){
+        log_stream_t *s = &logstate.streams[i];
+
+        if(!s->ring || s->count < FLASH_BLOCK_PAGES || capacity(s) - s->count >= LOG_PREERASE_PAGES)
+            continue;
+        reclaim(s);
+        return true;
+    }
+    return false;
+}
+
+
+uint16_t log_head(uint8_t stream)
+{
+    const log_stream_t *s = &logstate.streams[stream];
+    return page_at(s, s->count);
+}
+
+
+uint16_t log_tail(uint8_t stream)
+{
+    return logstate.streams[stream].tail;
+}
+
+
+uint16_t log_scratch_page(void)
+{
+    if(flash_num_pages() < FLASH_BLOCK_PAGES)
+        return LOG_NO_PAGE;
+    return flash_num_pages() - FLASH_BLOCK_PAGES;
+}
+
+
+bool log_oldest(uint8_t stream, log_end_t *end)
+{
+    *end = logstate.streams[stream].oldest;
+    return end->page != LOG_NO_PAGE;
+}
+
+
+bool log_newest(uint8_t stream, log_end_t *end)
+{
+    *end = logstate.streams[stream].newest;
+    return end->page != LOG_NO_PAGE;
+}
+
+
+uint16_t log_next(uint8_t stream, uint16_t pageno)
+{
+    const log_stream_t *s = &logstate.streams[stream];
+
+    if(++pageno == s->first + s->size && s->ring)
+        pageno = s->first;
+    return pageno;
+}
+
+
+bool log_read_header(uint16_t pageno, log_page_hdr_t *hdr)
+{
+    read_header(pageno, hdr);
+    return header_valid(hdr);
+}
+
+
+uint16_t log_find(uint8_t stream, uint32_t ts)
+{
+    const log_stream_t *s = &logstate.streams[stream];
+    uint16_t i;
+
+    if(s->newest.page == LOG_NO_PAGE)
+        return page_at(s, s->count);
+    if(ts >= s->newest.tbase)
+        return s->newest.page;
+    if(ts < s->oldest.tbase)
+        return s->oldest.page;
+    i = search_after(s, false, ts);
+    return page_at(s, (i > 0) ? i-1 : 0);
+}
+
+
+uint16_t log_find_seq(uint8_t stream, uint32_t seq)
+{
+    const log_stream_t *s = &logstate.streams[stream];
+    return page_at(s, (seq > 0) ? search_after(s, true, seq-1) : 0);
+}
+
+
+uint32_t log_sync_cursor(void)
+{
+    return logstate.sync.val;
+}
+
+
+void log_sync_ack(uint32_t seq)
+{
+    const log_end_t *newest = &logstate.streams[LOG_RAW].newest;
+
+    if(newest->page == LOG_NO_PAGE || seq == 0xffffffff)
+        return;     /* nothing committed or the cursor would wrap */
+    if(seq > newest->seq)
+        seq = newest->seq;  /* pages not written yet can't have been sent */
+    if(seq < logstate.sync.val)
+        return;     /* old or repeated acknowledge */
+    wl_store(sync_slots, &logstate.sync, seq+1);
+}
+
+
+uint16_t log_bad_pages(void)
+{
+    return logstate.bad;
+}
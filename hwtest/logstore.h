@@ -0,0 +1,330 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file logstore.h
+ * Power-fail-safe record log on top of the Adesto flash
+ *
+ * Records are collected in an SRAM buffer of the flash device and
+ * committed page by page. Every committed page carries a header with a
+ * CRC and a commit marker, so a page torn by a power loss can be detected
+ * and dropped during boot.
+ *
+ * The flash is split into two streams with a region and an SRAM buffer
+ * each. LOG_RAW holds the records as they come, LOG_SUMMARY holds the
+ * hour and day summaries and is kept when raw pages are reclaimed.
+ * The last block of the flash is a scratch block of the hardware tests.
+ *
+ * The retention of a full stream is set per stream at compile time.
+ * LOG_OVERWRITE runs the region as a ring: the oldest block is erased
+ * ahead of the write head and the tail is derived from a reclaim counter
+ * in the eeprom, so it survives a power loss. LOG_STOP keeps the oldest
+ * data and drops new records. The oldest and newest page of a stream are
+ * tracked in RAM and found again by log_recover without a full scan.
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#ifndef _LOGSTORE_H_
+#define _LOGSTORE_H_
+
+#include <stdbool.h>
+
+#include "flash.h"
+
+#define LOG_RAW      0  /**< raw records */
+#define LOG_SUMMARY  1  /**< hour and day summaries */
+#define LOG_STREAMS  2
+
+#define LOG_STOP       0  /**< a full stream drops new records */
+#define LOG_OVERWRITE  1  /**< a full stream reclaims its oldest block */
+
+#ifndef LOG_RAW_RETENTION
+#define LOG_RAW_RETENTION     LOG_OVERWRITE
+#endif
+
+#ifndef LOG_SUMMARY_RETENTION
+#define LOG_SUMMARY_RETENTION LOG_STOP
+#endif
+
+#ifndef LOG_SUMMARY_PAGES
+#define LOG_SUMMARY_PAGES (flash_num_pages()/16)  /**< region of LOG_SUMMARY in front of the scratch block */
+#endif
+
+#define LOG_MIN_PAGES (4*FLASH_BLOCK_PAGES)  /**< two blocks LOG_RAW, one LOG_SUMMARY and the scratch block */
+
+#ifndef LOG_PREERASE_PAGES
+#define LOG_PREERASE_PAGES (4*FLASH_BLOCK_PAGES)  /**< erased pages kept ahead of the write head */
+#endif
+
+/* results of log_commit */
+#define LOG_COMMITTED  0  /**< the open page is in the flash, or it was empty */
+#define LOG_FULL       1  /**< no erased page left, the page stays in its buffer */
+#define LOG_FAILED     2  /**< a block of pages failed to verify, the page stays in its buffer */
+#define LOG_BUSY       3  /**< another device holds the SPI bus, nothing was written */
+
+#define LOG_PAGE_MAGIC   0x4c  /**< 'L', marks a page written by the logger */
+#define LOG_SCHEMA_MAX   15    /**< magic is LOG_PAGE_MAGIC + schema id, see schema.h */
+#define LOG_COMMIT_MARK  0xa5  /**< last header byte, erased flash reads 0xff */
+
+/** header located in the last 16 bytes of each committed page.
+    With 528 bytes/page this is the spare area and the whole 512 bytes
+    are left for the payload. */
+typedef struct {
+    uint32_t seq;     /**< page sequence number */
+    uint32_t tbase;   /**< timestamp of the first record, see rv8523_getTimestamp */
+    uint16_t nbytes;  /**< payload bytes used in this page */
+    uint16_t nrec;    /**< number of records in this page */
+    uint16_t crc;     /**< crc ccitt over payload, seq, tbase, nbytes and nrec */
+    uint8_t  magic;   /**< LOG_PAGE_MAGIC + schema id of the records */
+    uint8_t  commit;  /**< LOG_COMMIT_MARK */
+} log_page_hdr_t;
+
+#define LOG_PAGE_SCHEMA(hdr) ((uint8_t)((hdr)->magic - LOG_PAGE_MAGIC))
+
+#define LOG_HDR_OFFSET   (flash_page_size() - sizeof(log_page_hdr_t))
+#define LOG_PAYLOAD_SIZE LOG_HDR_OFFSET  /**< usable bytes per page */
+
+#define LOG_NO_PAGE 0xffff  /**< log_end_t.page of an empty stream */
+
+/** oldest or newest committed page of a stream */
+typedef struct {
+    uint16_t page;   /**< page number, LOG_NO_PAGE if the stream is empty */
+    uint32_t seq;    /**< sequence number of the page */
+    uint32_t tbase;  /**< timestamp of its first record */
+} log_end_t;
+
+/** result of the boot recovery of LOG_RAW */
+typedef struct {
+    uint16_t head;    /**< first free page */
+    uint8_t  probes;  /**< number of page headers read */
+    bool     torn;    /**< last page was torn and has been dropped */
+} log_recovery_t;
+
+
+/**
+ * @brief log_format
+ *
+ * @desc erase the flash and start empty streams, the sync cursor is reset
+ * @note this requires 45-80sec!
+ */
+void log_format(void);
+
+
+/**
+ * @brief log_recover
+ *
+ * @desc find the write heads after a reset and drop torn last pages.
+ *       Uses a binary search over the page headers, no full-chip scan.
+ *       The oldest page of the ring streams and the sync cursor are
+ *       loaded from the eeprom.
+ * @note flash_init has to be called first to know the size of the device
+ *
+ * @param *info  filled with the recovery result of LOG_RAW, may be NULL
+ * @return false if another device holds the SPI bus, nothing was done, or
+ *         if the device is missing or smaller than LOG_MIN_PAGES. The
+ *         streams are left empty then and log_append refuses all records.
+ */
+bool log_recover(log_recovery_t *info);
+
+
+/**
+ * @brief log_append
+ *
+ * @desc append one record to the open page. A full page is committed first.
+ *
+ * @param stream  LOG_RAW or LOG_SUMMARY
+ * @param ts      timestamp of the record, becomes the page timestamp if first
+ * @param *rec    record data
+ * @param len     record length, 1..LOG_PAYLOAD_SIZE-1
+ * @return false if the stream is full, the full open page could not be
+ *         committed, the record is too large or another device holds the
+ *         SPI bus. The record is not stored then.
+ */
+bool log_append(uint8_t stream, uint32_t ts, const uint8_t *rec, uint8_t len);
+
+
+/**
+ * @brief log_commit
+ *
+ * @desc write the open page to the flash, nothing is done for an empty page.
+ *       A page failing the verify step is skipped and the next one is used,
+ *       up to FLASH_BLOCK_PAGES pages per call. Pre-erased pages are
+ *       programmed without erase. A LOG_OVERWRITE stream reclaims its
+ *       oldest block once if no erased block is left.
+ *
+ * @param stream  LOG_RAW or LOG_SUMMARY
+ * @return LOG_COMMITTED, or LOG_FULL/LOG_FAILED/LOG_BUSY with the open
+ *         page kept in its buffer, a later call tries again. LOG_BUSY
+ *         touched no page.
+ */
+uint8_t log_commit(uint8_t stream);
+
+
+/**
+ * @brief log_flush
+ *
+ * @desc fast commit of the open pages of all streams on a power fail.
+ *       Pages are programmed without verify and no block is reclaimed,
+ *       the open page of a full ring stays in its buffer.
+ */
+void log_flush(void);
+
+
+/**
+ * @brief log_maintain
+ *
+ * @desc reclaim the oldest block of a LOG_OVERWRITE stream if less than
+ *       LOG_PREERASE_PAGES erased pages are left ahead of its write head.
+ *       At most one erase is started per call. Call it during
+ *       otherwise idle wakes, so commits never wait for a block erase.
+ *       The erase runs in the background, reads suspend it meanwhile.
+ *
+ * @return true if a block erase was started
+ */
+bool log_maintain(void);
+
+
+/**
+ * @brief log_head
+ *
+ * @desc return the page that will be written by the next commit
+ *
+ * @param stream  LOG_RAW or LOG_SUMMARY
+ */
+uint16_t log_head(uint8_t stream);
+
+
+/**
+ * @brief log_tail
+ *
+ * @desc return the oldest page of a stream, log_head() if it is empty
+ *
+ * @param stream  LOG_RAW or LOG_SUMMARY
+ */
+uint16_t log_tail(uint8_t stream);
+
+
+/**
+ * @brief log_scratch_page
+ *
+ * @desc return the first page of the last block of the flash. The block
+ *       belongs to no stream, hardware tests and benchmarks may erase and
+ *       program it without destroying logged data.
+ * @note flash buffer 1 holds the open page of LOG_RAW, commit it first
+ *
+ * @return the page, LOG_NO_PAGE if no device was found
+ */
+uint16_t log_scratch_page(void);
+
+
+/**
+ * @brief log_oldest
+ *
+ * @desc return the oldest committed page of a stream. The ends are kept
+ *       up to date by log_commit and log_recover, no flash access is made.
+ *
+ * @param stream  LOG_RAW or LOG_SUMMARY
+ * @param *end    filled with page, seq and tbase of the oldest page
+ * @return false if the stream is empty
+ */
+bool log_oldest(uint8_t stream, log_end_t *end);
+
+
+/**
+ * @brief log_newest
+ *
+ * @desc return the last committed page of a stream, see log_oldest
+ *
+ * @param stream  LOG_RAW or LOG_SUMMARY
+ * @param *end    filled with page, seq and tbase of the newest page
+ * @return false if the stream is empty
+ */
+bool log_newest(uint8_t stream, log_end_t *end);
+
+
+/**
+ * @brief log_next
+ *
+ * @desc return the page following pageno within the region of a stream.
+ *       Walking from log_tail or log_find to log_head visits the pages
+ *       in the order they were written.
+ *
+ * @param stream  LOG_RAW or LOG_SUMMARY
+ * @param pageno  a page of the stream
+ */
+uint16_t log_next(uint8_t stream, uint16_t pageno);
+
+
+/**
+ * @brief log_read_header
+ *
+ * @desc read the 16 byte header of a committed page
+ *
+ * @param pageno  page to read
+ * @param *hdr    filled with the header
+ * @return true if the header is valid (the payload crc is not checked)
+ */
+bool log_read_header(uint16_t pageno, log_page_hdr_t *hdr);
+
+
+/**
+ * @brief log_find
+ *
+ * @desc find the page holding the records of a point in time.
+ *       The page headers act as a time index: a binary search reads
+ *       only the 16 header bytes of O(log n) pages. Timestamps outside
+ *       the stream are answered from the tracked ends without a search.
+ *
+ * @param stream  LOG_RAW or LOG_SUMMARY
+ * @param ts      timestamp to look for, see rv8523_getTimestamp
+ * @return last page starting at or before ts, oldest page if all pages are
+ *         younger, log_head() if the stream is empty
+ */
+uint16_t log_find(uint8_t stream, uint32_t ts);
+
+
+/**
+ * @brief log_find_seq
+ *
+ * @desc find the first page with a sequence number of at least seq
+ *
+ * @param stream  LOG_RAW or LOG_SUMMARY
+ * @param seq     sequence number to look for
+ * @return page number, log_head() if there is no such page
+ */
+uint16_t log_find_seq(uint8_t stream, uint32_t seq);
+
+
+/**
+ * @brief log_sync_cursor
+ *
+ * @desc return the first sequence number of LOG_RAW the host has not
+ *       acknowledged yet
+ */
+uint32_t log_sync_cursor(void);
+
+
+/**
+ * @brief log_sync_ack
+ *
+ * @desc the host acknowledges all pages of LOG_RAW up to and including seq.
+ *       The cursor is kept in the eeprom, spread over 16 slots to limit
+ *       wear, so no flash page has to be rewritten per sync.
+ *       Acknowledges below the current cursor are ignored, acknowledges
+ *       beyond the newest committed page are clamped to it.
+ *
+ * @param seq  highest sequence number received by the host
+ */
+void log_sync_ack(uint32_t seq);
+
+
+/**
+ * @brief log_bad_pages
+ *
+ * @desc return the number of pages skipped since boot as they failed to verify
+ */
+uint16_t log_bad_pages(void);
+
+#endif
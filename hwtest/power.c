@@ -0,0 +1,89 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file power.c
+ * Power fail detection with the bandgap reference
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <avr/interrupt.h>
+#include <avr/power.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+
+#include "clock.h"
+#include "flash.h"
+#include "logstore.h"
+#include "power.h"
+
+#define ADMUX_BANDGAP  0x0e  /**< MUX3:0 selecting the 1.1V bandgap */
+
+#if(POWER_FAULT_INJECTION)
+uint16_t power_fault_mv = 0;
+#endif
+
+
+/*
+ * global functions
+ */
+
+uint16_t power_vcc_mv(void)
+{
+    uint16_t sum = 0;
+    uint8_t i;
+
+#if(POWER_FAULT_INJECTION)
+    if(power_fault_mv)
+        return power_fault_mv;
+#endif
+    power_adc_enable();
+    ADMUX = _BV(REFS0) | ADMUX_BANDGAP;             /* AVcc reference */
+    ADCSRA = _BV(ADEN) | _BV(ADPS2) | _BV(ADPS1);   /* F_CPU/64 = 173kHz */
+    clock_delay_us(70);                             /* bandgap start-up */
+
+    /* the first conversion after switching the input is dropped */
+    for(i=0; i<=POWER_SAMPLES; ++i){
+        ADCSRA |= _BV(ADSC);
+        loop_until_bit_is_clear(ADCSRA, ADSC);
+        if(i)
+            sum += ADC;
+    }
+    ADCSRA = 0;
+    power_adc_disable();
+
+    if(sum == 0)
+        return 0xffff;
+    return (uint32_t)POWER_BANDGAP_MV * 1024 * POWER_SAMPLES / sum;
+}
+
+
+bool power_low(void)
+{
+    return power_vcc_mv() < POWER_WARN_MV;
+}
+
+
+void power_fail(void)
+{
+    cli();
+    wdt_disable();
+    log_flush();
+    eeprom_busy_wait();
+    flash_sleep(0xffff);
+#if(POWER_FAULT_INJECTION)
+    if(power_fault_mv){
+        power_fault_mv = 0;
+        return;
+    }
+#endif
+
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    sleep_enable();
+    for(;;)
+        sleep_cpu();
+}
@@ -0,0 +1,80 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file power.h
+ * Power fail detection with the bandgap reference
+ *
+ * The ADC measures the 1.1V bandgap against AVcc, which gives VCC without
+ * any external divider (the comparator inputs AIN0/AIN1 are used by the
+ * button and the LED). sampler_sample runs the check once per interval.
+ * Below POWER_WARN_MV the open log pages are committed and the cpu halts
+ * until the next reset, before the brown-out detector or the flash
+ * (2.3V) give up.
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#ifndef _POWER_H_
+#define _POWER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef POWER_WARN_MV
+#define POWER_WARN_MV      2900   /**< early warning level, leave room for two page commits */
+#endif
+
+#ifndef POWER_BANDGAP_MV
+#define POWER_BANDGAP_MV   1100   /**< nominal, +-10%, calibrate per board */
+#endif
+
+#define POWER_SAMPLES      4      /**< conversions averaged per measurement */
+
+#ifndef POWER_FAULT_INJECTION
+#define POWER_FAULT_INJECTION 0
+#endif
+
+
+/**
+ * @brief power_vcc_mv
+ *
+ * @desc measure the supply voltage, the ADC is switched off afterwards
+ *
+ * @return VCC in mV
+ */
+uint16_t power_vcc_mv(void);
+
+
+/**
+ * @brief power_low
+ *
+ * @desc return true if VCC dropped below POWER_WARN_MV
+ */
+bool power_low(void);
+
+
+/**
+ * @brief power_fail
+ *
+ * @desc commit the open pages of all log streams, let a pending eeprom
+ *       write complete, power down the flash and halt. Only a reset, e.g.
+ *       by the brown-out detector or a fresh battery, starts again.
+ * @note does not return, unless the drop was faked with power_fault_mv
+ */
+void power_fail(void);
+
+
+#if(POWER_FAULT_INJECTION)
+/**
+ * @brief power_fault_mv
+ *
+ * @desc if set, power_vcc_mv returns this value instead of measuring and
+ *       power_fail clears it and returns with interrupts disabled instead
+ *       of halting. Lets hwtest run the power fail path on a good supply.
+ */
+extern uint16_t power_fault_mv;
+#endif
+
+#endif
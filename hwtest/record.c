@@ -0,0 +1,59 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file record.c
+ * Pack routines generated from schema.h
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#include <stdint.h>
+
+#include "record.h"
+
+
+/*
+ * local functions
+ */
+
+/* append bits of val at bit position *pos, saturated to the field width */
+static void put_bits(uint8_t *buf, uint16_t *pos, uint32_t val, uint8_t bits)
+{
+    uint8_t shift, n;
+
+    if(bits < 32 && (val >> bits))
+        val = ((uint32_t)1 << bits) - 1;
+    buf += *pos >> 3;
+    shift = *pos & 7;
+    *pos += bits;
+    while(bits){
+        n = 8 - shift;
+        if(n > bits)
+            n = bits;
+        if(shift == 0)
+            *buf = 0;
+        *buf |= (uint8_t)((val & ((1 << n) - 1)) << shift);
+        val >>= n;
+        bits -= n;
+        shift = 0;
+        ++buf;
+    }
+}
+
+
+/*
+ * global functions
+ */
+
+#define RECORD_PACK_FIELD(l, field, bits)  put_bits(buf, &pos, rec->field, bits);
+#define RECORD_PACK(l, fields) \
+uint8_t rec_pack_##l(const rec_##l##_t *rec, uint8_t *buf) \
+{ \
+    uint16_t pos = 0; \
+    put_bits(buf, &pos, rec->type, 8); \
+    fields(RECORD_PACK_FIELD, l) \
+    return (pos + 7) / 8; \
+}
+SCHEMA_LAYOUTS(RECORD_PACK)
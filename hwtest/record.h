@@ -0,0 +1,92 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file record.h
+ * Records generated from schema.h
+ *
+ * For each layout l of the schema this provides
+ *   rec_l_t                     the unpacked record, type plus fields
+ *   REC_SIZE(l)                 bytes of the packed record
+ *   rec_pack_l(rec, buf)        pack into buf, returns the length
+ *   rec_l_<field>(buf)          read one field straight from a packed record
+ * and REC_<name> for the type byte of each record. The header has no AVR
+ * dependencies, the host decoder includes it as well.
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#ifndef _RECORD_H_
+#define _RECORD_H_
+
+#include <stdint.h>
+
+#include "schema.h"
+
+/* record types */
+#define RECORD_TYPE(name, type, l)  REC_##name = type,
+enum { SCHEMA_RECORDS(RECORD_TYPE) };
+#undef RECORD_TYPE
+
+/* unpacked records */
+#define RECORD_MEMBER(l, field, bits)  uint32_t field;
+#define RECORD_STRUCT(l, fields)  typedef struct { uint8_t type; fields(RECORD_MEMBER, l) } rec_##l##_t;
+SCHEMA_LAYOUTS(RECORD_STRUCT)
+#undef RECORD_STRUCT
+#undef RECORD_MEMBER
+
+/* bit position of each field, REC_BITS_l is the total length */
+#define RECORD_POS(l, field, bits)  REC_POS_##l##_##field, REC_END_##l##_##field = REC_POS_##l##_##field + (bits) - 1,
+#define RECORD_LAYOUT_POS(l, fields)  enum { REC_POS_##l##_type = 0, REC_END_##l##_type = 7, fields(RECORD_POS, l) REC_BITS_##l };
+SCHEMA_LAYOUTS(RECORD_LAYOUT_POS)
+#undef RECORD_LAYOUT_POS
+#undef RECORD_POS
+
+#define REC_SIZE(l)  ((REC_BITS_##l + 7) / 8)
+
+/* largest packed record */
+#define RECORD_SIZE_MAX_SIZE(l, fields)  uint8_t l[REC_SIZE(l)];
+typedef union { SCHEMA_LAYOUTS(RECORD_SIZE_MAX_SIZE) } rec_any_packed_t;
+#undef RECORD_SIZE_MAX_SIZE
+#define REC_SIZE_MAX  sizeof(rec_any_packed_t)
+
+
+/**
+ * @brief record_get
+ *
+ * @desc read a field of up to 32 bits from a packed record
+ *
+ * @param *rec  packed record
+ * @param pos   bit position of the field
+ * @param bits  width of the field
+ */
+static inline uint32_t record_get(const uint8_t *rec, uint16_t pos, uint8_t bits)
+{
+    uint32_t val = 0;
+    uint8_t got = 0;
+
+    rec += pos >> 3;
+    pos &= 7;
+    while(got < bits){
+        val |= (uint32_t)(*rec++ >> pos) << got;
+        got += 8 - pos;
+        pos = 0;
+    }
+    return (bits < 32) ? val & (((uint32_t)1 << bits) - 1) : val;
+}
+
+/* zero copy accessors rec_l_<field>(const uint8_t *rec) */
+#define RECORD_GETTER(l, field, bits) \
+    static inline uint32_t rec_##l##_##field(const uint8_t *rec) { return record_get(rec, REC_POS_##l##_##field, bits); }
+#define RECORD_LAYOUT_GETTERS(l, fields)  fields(RECORD_GETTER, l)
+SCHEMA_LAYOUTS(RECORD_LAYOUT_GETTERS)
+#undef RECORD_LAYOUT_GETTERS
+#undef RECORD_GETTER
+
+/* pack routines rec_pack_l, implemented in record.c */
+#define RECORD_PACK_PROTO(l, fields)  uint8_t rec_pack_##l(const rec_##l##_t *rec, uint8_t *buf);
+SCHEMA_LAYOUTS(RECORD_PACK_PROTO)
+#undef RECORD_PACK_PROTO
+
+#endif
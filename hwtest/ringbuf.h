@@ -0,0 +1,82 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file ringbuf.h
+ * Lock-free single producer / single consumer ring buffer
+ *
+ * RINGBUF_DEFINE(name, type, size) defines the ring type name_t for
+ * elements of type and the functions
+ *   bool    name_push(name_t *rb, const type *val)   producer, e.g. an ISR
+ *   bool    name_pop(name_t *rb, type *val)          consumer
+ *   uint8_t name_pop_batch(name_t *rb, type *buf, uint8_t max)
+ *   uint8_t name_count(name_t *rb)
+ *
+ * head is only written by the producer and tail only by the consumer.
+ * Both are single bytes, which the AVR reads and writes atomically, so
+ * no interrupt has to be disabled. The indices run freely, size has to be
+ * a power of two up to 128. Several ISRs may push into the same ring as
+ * long as they do not interrupt each other, i.e. without ISR_NOBLOCK.
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#ifndef _RINGBUF_H_
+#define _RINGBUF_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* keeps the compiler from moving element accesses across an index update */
+#define RINGBUF_BARRIER  __asm__ __volatile__("" ::: "memory")
+
+#define RINGBUF_DEFINE(name, type, size)                                      \
+typedef char name##_size_check[(((size) & ((size)-1)) == 0 && (size) <= 128) ? 1 : -1]; \
+                                                                              \
+typedef struct {                                                              \
+    volatile uint8_t head;     /**< next slot to write, producer only */     \
+    volatile uint8_t tail;     /**< next slot to read, consumer only */      \
+    volatile uint8_t dropped;  /**< pushes lost as the ring was full */      \
+    type buf[size];                                                           \
+} name##_t;                                                                   \
+                                                                              \
+static inline bool name##_push(name##_t *rb, const type *val)                 \
+{                                                                             \
+    uint8_t head = rb->head;                                                  \
+    if((uint8_t)(head - rb->tail) >= (size)){                                 \
+        ++rb->dropped;                                                        \
+        return false;                                                         \
+    }                                                                         \
+    rb->buf[head & ((size)-1)] = *val;                                        \
+    RINGBUF_BARRIER;                                                          \
+    rb->head = head + 1;                                                      \
+    return true;                                                              \
+}                                                                             \
+                                                                              \
+static inline uint8_t name##_pop_batch(name##_t *rb, type *buf, uint8_t max)  \
+{                                                                             \
+    uint8_t tail = rb->tail;                                                  \
+    uint8_t n = rb->head - tail;                                              \
+    uint8_t i;                                                                \
+    if(n > max)                                                               \
+        n = max;                                                              \
+    RINGBUF_BARRIER;                                                          \
+    for(i=0; i<n; ++i)                                                        \
+        buf[i] = rb->buf[(uint8_t)(tail + i) & ((size)-1)];                   \
+    RINGBUF_BARRIER;                                                          \
+    rb->tail = tail + n;                                                      \
+    return n;                                                                 \
+}                                                                             \
+                                                                              \
+static inline bool name##_pop(name##_t *rb, type *val)                        \
+{                                                                             \
+    return name##_pop_batch(rb, val, 1) != 0;                                 \
+}                                                                             \
+                                                                              \
+static inline uint8_t name##_count(name##_t *rb)                              \
+{                                                                             \
+    return rb->head - rb->tail;                                               \
+}
+
+#endif
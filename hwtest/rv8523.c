@@ -12,8 +12,10 @@
  */
 
 #include <stdbool.h>
+#include <avr/pgmspace.h>
 
-#include "i2cmaster.h"
+#include "i2creg.h"
+#include "bcd.h"
 #include "rv8523_regs.h"
 #include "rv8523.h"
 
@@ -22,52 +24,24 @@
  */
 
 
-static uint8_t bcd_to_dec(uint8_t x)
-{
-    return x - 6 * (x>>4);
-}
-
-static uint8_t dec_to_bcd(uint8_t x)
-{
-    return x + 6 * (x/10);
-}
-
-
 static uint8_t read_reg(uint8_t regno){
-    uint8_t ret;
-    i2c_start_wait(DEV_RV8523+I2C_WRITE);
-    i2c_write(regno);
-    i2c_rep_start(DEV_RV8523+I2C_READ);
-    ret = i2c_readNak();
-    i2c_stop();
+    uint8_t ret = 0;
+    i2c_read_regs(DEV_RV8523, regno, 1, &ret);
     return ret;
 }
 
 static void read_nregs(uint8_t start_regno, uint8_t nregs, uint8_t *pvalues){
-    i2c_start_wait(DEV_RV8523+I2C_WRITE);
-    i2c_write(start_regno);
-    i2c_rep_start(DEV_RV8523+I2C_READ);
-    for(; nregs>1; --nregs, pvalues++)
-        *pvalues = i2c_readAck();
-    *pvalues = i2c_readNak();
-    i2c_stop();
+    i2c_read_regs(DEV_RV8523, start_regno, nregs, pvalues);
 }
 
 
 static void write_reg(uint8_t regno, uint8_t value){
-    i2c_start_wait(DEV_RV8523+I2C_WRITE);
-    i2c_write(regno);
-    i2c_write(value);
-    i2c_stop();
+    i2c_write_regs(DEV_RV8523, regno, 1, &value);
 }
 
 static void write_nregs(uint8_t start_regno, uint8_t nregs, const uint8_t *pvalues)
 {
-    i2c_start_wait(DEV_RV8523+I2C_WRITE);
-    i2c_write(start_regno);
-    for(; nregs>0; --nregs, ++pvalues)
-        i2c_write(*pvalues);
-    i2c_stop();    
+    i2c_write_regs(DEV_RV8523, start_regno, nregs, pvalues);
 }
 
 /*
@@ -128,6 +102,31 @@ bool rv8523_getDateTime24(uint8_t *year, uint8_t *month, uint8_t *day, uint8_t *
 }
 
 
+uint32_t rv8523_toTimestamp(uint8_t year, uint8_t month, uint8_t day,
+                            uint8_t hour, uint8_t min, uint8_t sec)
+{
+    static const uint16_t days_before_month[12] PROGMEM =
+        {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+    uint16_t days;
+
+    if(month < 1 || month > 12)
+        month = 1;
+    days = (uint16_t)year*365 + (year+3)/4 + pgm_read_word(&days_before_month[month-1]) + day - 1;
+    if(!(year & 0x03) && month > 2)
+        ++days;    /* leap day of the current year */
+    return (((uint32_t)days*24 + hour)*60 + min)*60 + sec;
+}
+
+
+uint32_t rv8523_getTimestamp(void)
+{
+    uint8_t year, month, day, weekday, hour, min, sec;
+
+    rv8523_getDateTime24(&year, &month, &day, &weekday, &hour, &min, &sec, false);
+    return rv8523_toTimestamp(year, month, day, hour, min, sec);
+}
+
+
 void rv8523_setDateTime24(uint8_t year, uint8_t month, uint8_t day, uint8_t weekday,
                           uint8_t hour, uint8_t min, uint8_t sec, bool bcd_mode)
 {
@@ -220,8 +219,38 @@ void rv8523_setAlarmIrq(bool enable)
 
 void rv8523_clearAlarmFlag(void)
 {
-    /* \fixme we destroy the watchdog timer settings here! */
-    write_reg(RV8523_CONTROL2, 0x70); /* clear AF only */    
+    /* flags are cleared by writing 0, keep the interrupt enables */
+    write_reg(RV8523_CONTROL2, (read_reg(RV8523_CONTROL2) & 0x07) | 0x70); /* clear AF only */
+}
+
+
+void rv8523_setTimerA(uint16_t seconds)
+{
+    uint8_t vals[2];
+    uint8_t ctrl2 = (read_reg(RV8523_CONTROL2) & 0x07) | 0xf8;  /* keep all flags */
+
+    if(seconds == 0){
+        write_reg(RV8523_CONTROL2, ctrl2 & ~0x02);  /* CTAIE off */
+        write_reg(RV8523_TIMER_CLOCKOUT, 0x38);     /* timer A disabled, no CLKOUT */
+        return;
+    }
+    if(seconds <= 255){
+        vals[0] = 0x02;                    /* 1Hz source */
+        vals[1] = seconds;
+    }else{
+        vals[0] = 0x03;                    /* 1/60Hz source */
+        seconds = (seconds + 30) / 60;
+        vals[1] = (seconds > 255) ? 255 : seconds;
+    }
+    write_nregs(RV8523_TIMER_A_CLOCK, 2, vals);
+    write_reg(RV8523_TIMER_CLOCKOUT, 0xba);        /* pulsed interrupt, countdown timer A */
+    write_reg(RV8523_CONTROL2, ctrl2 | 0x02);      /* CTAIE on */
+}
+
+
+void rv8523_clearTimerFlag(void)
+{
+    write_reg(RV8523_CONTROL2, (read_reg(RV8523_CONTROL2) & 0x07) | 0xb8); /* clear CTAF only */
 }
 
 
@@ -67,6 +67,28 @@ bool rv8523_getDateTime24(uint8_t *year, uint8_t *month, uint8_t *day, uint8_t *
                           uint8_t *hour, uint8_t *min, uint8_t *sec, bool bcd_mode);
 
 
+/**
+ * @brief rv8523_getTimestamp
+ *
+ * @desc Returns the time of the RTC as seconds since 01.01.2000 00:00:00.
+ *       Valid until 2099 as the RTC only stores 2 year digits.
+ *
+ * @return seconds since 01.01.2000
+ */
+uint32_t rv8523_getTimestamp(void);
+
+
+/**
+ * @brief rv8523_toTimestamp
+ *
+ * @desc Converts a date and time (decimal, 24h) to seconds since 01.01.2000.
+ *
+ * @return seconds since 01.01.2000
+ */
+uint32_t rv8523_toTimestamp(uint8_t year, uint8_t month, uint8_t day,
+                            uint8_t hour, uint8_t min, uint8_t sec);
+
+
 /**
  * @brief rv8523_setDateTime24
  *
@@ -156,6 +178,25 @@ void rv8523_setAlarmIrq(bool enable);
 void rv8523_clearAlarmFlag(void);
 
 
+/**
+ * @brief set periodic timer
+ *
+ * @desc runs countdown timer A with auto reload, every period pulses INT1.
+ *       Periods up to 255s are exact, longer ones are rounded to minutes.
+ *
+ * @param seconds  period, 1..15300s, 0 stops the timer
+ */
+void rv8523_setTimerA(uint16_t seconds);
+
+
+/**
+ * @brief clear timer interrupt status
+ *
+ * @desc clears the countdown timer A interrupt flag of the RTC
+ */
+void rv8523_clearTimerFlag(void);
+
+
 void rv8523_getAllRegs(uint8_t *ptr);
 
 #endif
@@ -0,0 +1,162 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file sampler.c
+ * Adaptive sampling rate driven by the activity of the signal
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "rv8523.h"
+#include "logstore.h"
+#include "power.h"
+#include "summary.h"
+#include "sampler.h"
+#include "warmboot.h"
+
+#define SECONDS_PER_DAY  86400UL
+
+static struct {
+    bool     started;     /**< a first sample has been taken */
+    uint16_t interval;    /**< current interval in s */
+    uint32_t prev;        /**< previous sample */
+    uint32_t activity;    /**< average change between samples */
+    uint32_t saved_val;   /**< last sample in the log */
+    uint32_t saved_ts;    /**< its timestamp */
+    uint16_t day;         /**< day the counters belong to */
+    uint16_t taken;       /**< samples taken today */
+    uint16_t saved;       /**< samples logged today */
+} sampler NOINIT;
+
+
+/*
+ * local functions
+ */
+
+/* change regarded as significant at the level val */
+static uint32_t threshold(uint32_t val)
+{
+    return val/SAMPLER_REL_DIV + SAMPLER_ABS_MIN;
+}
+
+static uint32_t distance(uint32_t a, uint32_t b)
+{
+    return (a > b) ? a-b : b-a;
+}
+
+static void set_interval(uint16_t interval)
+{
+    if(interval == sampler.interval)
+        return;
+    sampler.interval = interval;
+    rv8523_setTimerA(interval);
+}
+
+static void log_day(void)
+{
+    rec_day_t rec;
+    uint8_t buf[REC_SIZE(day)];
+
+    rec.type = SAMPLER_REC_DAY;
+    rec.day = sampler.day;
+    rec.taken = sampler.taken;
+    rec.saved = sampler.saved;
+    log_append(LOG_SUMMARY, (uint32_t)sampler.day * SECONDS_PER_DAY, buf, rec_pack_day(&rec, buf));
+}
+
+static bool log_sample(uint32_t ts, uint32_t value)
+{
+    rec_sample_t rec;
+    uint8_t buf[REC_SIZE(sample)];
+
+    rec.type = SAMPLER_REC_SAMPLE;
+    rec.ts = ts;
+    rec.value = value;
+    return log_append(LOG_RAW, ts, buf, rec_pack_sample(&rec, buf));
+}
+
+
+/*
+ * global functions
+ */
+
+void sampler_init(void)
+{
+    sampler.started = false;
+    sampler.interval = 0;
+    sampler.taken = 0;
+    sampler.saved = 0;
+    set_interval(SAMPLER_MIN_S);
+}
+
+
+bool sampler_sample(uint32_t ts, uint32_t value)
+{
+    uint16_t day = ts / SECONDS_PER_DAY;
+    uint32_t delta, thr;
+    bool save;
+
+    if(!sampler.started){
+        sampler.started = true;
+        sampler.prev = value;
+        sampler.activity = 0;
+        sampler.day = day;
+        save = true;
+    }else{
+        if(day != sampler.day){
+            log_day();
+            sampler.day = day;
+            sampler.taken = 0;
+            sampler.saved = 0;
+        }
+
+        /* slope to the previous sample and its running average */
+        delta = distance(value, sampler.prev);
+        sampler.activity = sampler.activity - sampler.activity/4 + delta/4;
+        thr = threshold(sampler.prev);
+        sampler.prev = value;
+
+        if(delta > thr || sampler.activity > thr)
+            set_interval(SAMPLER_MIN_S);         /* react at once */
+        else if(sampler.activity < thr/2 && sampler.interval < SAMPLER_MAX_S)
+            set_interval(sampler.interval * 2);  /* back off */
+
+        save = (distance(value, sampler.saved_val) > threshold(sampler.saved_val))
+            || (ts - sampler.saved_ts >= SAMPLER_KEEPALIVE_S);
+    }
+
+    summary_add(ts, value, sampler.interval);
+    ++sampler.taken;
+    save = save && log_sample(ts, value);
+    if(save){
+        sampler.saved_val = value;
+        sampler.saved_ts = ts;
+        ++sampler.saved;
+    }
+
+    /* a sinking supply is caught within one interval, this sample included */
+    if(power_low())
+        power_fail();
+
+    /* the idle rest of the wake erases ahead of the log, not the next commit */
+    log_maintain();
+    return save;
+}
+
+
+uint16_t sampler_interval(void)
+{
+    return sampler.interval;
+}
+
+
+void sampler_today(uint16_t *taken, uint16_t *saved)
+{
+    *taken = sampler.taken;
+    *saved = sampler.saved;
+}
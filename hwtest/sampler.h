@@ -0,0 +1,79 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file sampler.h
+ * Adaptive sampling rate driven by the activity of the signal
+ *
+ * Each sample is compared with the previous one. A change above the
+ * threshold drops the interval to SAMPLER_MIN_S at once, a stable signal
+ * doubles the interval up to SAMPLER_MAX_S. The interval is programmed
+ * into timer A of the RV-8523, which wakes the controller via INT1.
+ * Only samples differing from the last saved one, or older than
+ * SAMPLER_KEEPALIVE_S, are appended to LOG_RAW. All samples are passed
+ * on to the hour and day summaries.
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#ifndef _SAMPLER_H_
+#define _SAMPLER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "record.h"
+
+#define SAMPLER_MIN_S        60      /**< fastest sampling interval */
+#define SAMPLER_MAX_S        1920    /**< slowest interval, SAMPLER_MIN_S * 2^n */
+#define SAMPLER_KEEPALIVE_S  3600    /**< a sample is saved at least this often */
+#define SAMPLER_REL_DIV      8       /**< relative threshold, 1/8 of the value */
+#define SAMPLER_ABS_MIN      1000    /**< absolute threshold, 1lx in millilux */
+
+/* log record types, the layouts rec_sample_t and rec_day_t are in schema.h */
+#define SAMPLER_REC_SAMPLE   REC_SAMPLE  /**< LOG_RAW: a saved sample */
+#define SAMPLER_REC_DAY      REC_DAY     /**< LOG_SUMMARY: end of each day, to tune the thresholds */
+
+
+/**
+ * @brief sampler_init
+ *
+ * @desc start sampling at the fastest interval
+ * @note the RTC timer A interrupt is enabled, INT1 pulses once per interval
+ */
+void sampler_init(void);
+
+
+/**
+ * @brief sampler_sample
+ *
+ * @desc process one sample: adapt the interval, reprogram the RTC if it
+ *       changed, update the summaries, log the sample if required and log
+ *       the counters of the previous day at the first sample of a new day.
+ *       Finally the supply is checked, see power_fail, and the log is
+ *       kept erased ahead of its head, see log_maintain.
+ *
+ * @param ts     timestamp of the sample, see rv8523_getTimestamp
+ * @param value  sample value, e.g. millilux
+ * @return true if the sample was appended to LOG_RAW
+ */
+bool sampler_sample(uint32_t ts, uint32_t value);
+
+
+/**
+ * @brief sampler_interval
+ *
+ * @desc return the current sampling interval in seconds
+ */
+uint16_t sampler_interval(void);
+
+
+/**
+ * @brief sampler_today
+ *
+ * @desc return the samples taken and saved on the current day
+ */
+void sampler_today(uint16_t *taken, uint16_t *saved);
+
+#endif
@@ -0,0 +1,64 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file schema.h
+ * Layout of all log records, the single source for firmware and host
+ *
+ * A record starts with its 8 bit type, the fields follow without padding,
+ * each one with the number of bits given here, LSB first. Values too
+ * large for a field are saturated by the pack routines. record.h turns
+ * these lists into structs, pack routines, bit positions and accessors.
+ *
+ * SCHEMA_ID is stored in every page header, increase it with any change
+ * of the lists below so older pages stay decodable.
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#ifndef _SCHEMA_H_
+#define _SCHEMA_H_
+
+#define SCHEMA_ID  1   /**< 1..15, 0 are the byte aligned records before the schema */
+
+/* fields of a layout: X(layout, field, bits), at most 32 bits each */
+#define SCHEMA_LAYOUT_SAMPLE(X, l)  \
+    X(l, ts,      32)   /* timestamp, see rv8523_getTimestamp */ \
+    X(l, value,   27)   /* millilux, the BH1750 reaches 121.5klx */
+
+#define SCHEMA_LAYOUT_DAY(X, l)     \
+    X(l, day,     16)   /* days since 2000-01-01 */ \
+    X(l, taken,   11)   /* samples taken, at most 1440 */ \
+    X(l, saved,   11)   /* samples appended to the log */
+
+#define SCHEMA_LAYOUT_SUMMARY(X, l) \
+    X(l, start,   32)   /* first second of the period */ \
+    X(l, min,     27)   \
+    X(l, max,     27)   \
+    X(l, mean,    27)   /* weighted with the time each sample stood for */ \
+    X(l, count,   11)   /* number of samples */
+
+#define SCHEMA_LAYOUT_QUANT(X, l)   \
+    X(l, start,   32)   /* first second of the day */ \
+    X(l, minutes, 11)   /* time covered by the samples */ \
+    X(l, p5,      27)   \
+    X(l, p50,     27)   \
+    X(l, p95,     27)
+
+/* layouts: L(layout, fields) */
+#define SCHEMA_LAYOUTS(L) \
+    L(sample,  SCHEMA_LAYOUT_SAMPLE) \
+    L(day,     SCHEMA_LAYOUT_DAY) \
+    L(summary, SCHEMA_LAYOUT_SUMMARY) \
+    L(quant,   SCHEMA_LAYOUT_QUANT)
+
+/* records: R(name, type, layout), the type is the first byte */
+#define SCHEMA_RECORDS(R) \
+    R(SAMPLE,  'S', sample)   /* LOG_RAW: a saved sample */ \
+    R(DAY,     'D', day)      /* LOG_SUMMARY: sampler statistics of a day */ \
+    R(HOUR,    'h', summary)  /* LOG_SUMMARY: hour summary */ \
+    R(DAYSUM,  'd', summary)  /* LOG_SUMMARY: day summary */ \
+    R(QUANT,   'q', quant)    /* LOG_SUMMARY: p5, p50, p95 of a day */
+
+#endif
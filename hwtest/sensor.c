@@ -0,0 +1,140 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file sensor.c
+ * Driver framework for the sensors on the I2C0/I2C1/I2C2 connectors
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#include "clock.h"
+#include "sensor.h"
+#include "bh1750.h"
+
+/* timer1 at F_CPU/64, converted to us at the current clock divider */
+#define TICKS_US(ticks)  (((uint32_t)(ticks) * 64000UL / (F_CPU/1000)) << clock_get_div())
+
+/* registered drivers, unused slots are NULL */
+static const sensor_driver_t * const registry[SENSOR_MAX] PROGMEM = {
+    &bh1750_driver,
+};
+
+static uint8_t present;    /**< bit i is set if slot i was found */
+static sensor_reading_t readings[SENSOR_MAX];
+
+
+/*
+ * local functions
+ */
+
+/* copy the driver of slot idx to RAM, false if the slot is empty */
+static bool get_driver(uint8_t idx, sensor_driver_t *drv)
+{
+    const sensor_driver_t *p = (const sensor_driver_t *)pgm_read_word(&registry[idx]);
+
+    if(p == NULL)
+        return false;
+    memcpy_P(drv, p, sizeof(*drv));
+    return true;
+}
+
+
+/*
+ * global functions
+ */
+
+uint8_t sensor_probe_all(void)
+{
+    sensor_driver_t drv;
+    uint8_t i, n = 0;
+
+    present = 0;
+    for(i=0; i<SENSOR_MAX; ++i){
+        if(!get_driver(i, &drv) || !drv.probe() || !drv.configure())
+            continue;
+        present |= _BV(i);
+        ++n;
+    }
+    return n;
+}
+
+
+bool sensor_present(uint8_t idx)
+{
+    return (idx < SENSOR_MAX) && (present & _BV(idx));
+}
+
+
+const char *sensor_name(uint8_t idx)
+{
+    sensor_driver_t drv;
+    return get_driver(idx, &drv) ? drv.name : NULL;
+}
+
+
+uint8_t sensor_sample_all(void)
+{
+    sensor_driver_t drv;
+    uint16_t t_trigger[SENSOR_MAX];
+    uint16_t t0, conv_ms, wait_ms = 0;
+    uint8_t i, n = 0;
+
+    TCCR1A = 0;
+    TCNT1 = 0;
+    TCCR1B = _BV(CS11) | _BV(CS10);
+
+    /* start all conversions back to back */
+    for(i=0; i<SENSOR_MAX; ++i){
+        if(!(present & _BV(i)))
+            continue;
+        get_driver(i, &drv);
+        t_trigger[i] = TCNT1;
+        conv_ms = drv.trigger();
+        readings[i].bus_us = TICKS_US(TCNT1 - t_trigger[i]);
+        if(conv_ms > wait_ms)
+            wait_ms = conv_ms;
+    }
+
+    /* one wait covers all of them, the earlier triggers had a head start */
+    clock_delay_ms(wait_ms);
+
+    for(i=0; i<SENSOR_MAX; ++i){
+        if(!(present & _BV(i)))
+            continue;
+        get_driver(i, &drv);
+        t0 = TCNT1;
+        readings[i].len = drv.read(readings[i].data);
+        readings[i].bus_us += TICKS_US(TCNT1 - t0);
+        readings[i].latency_us = TICKS_US(TCNT1 - t_trigger[i]);
+        if(readings[i].len)
+            ++n;
+    }
+
+    TCCR1B = 0;
+    return n;
+}
+
+
+const sensor_reading_t *sensor_get(uint8_t idx)
+{
+    return &readings[idx];
+}
+
+
+void sensor_powerdown_all(void)
+{
+    sensor_driver_t drv;
+    uint8_t i;
+
+    for(i=0; i<SENSOR_MAX; ++i)
+        if((present & _BV(i)) && get_driver(i, &drv))
+            drv.powerdown();
+}
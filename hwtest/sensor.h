@@ -0,0 +1,99 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file sensor.h
+ * Driver framework for the sensors on the I2C0/I2C1/I2C2 connectors
+ *
+ * Every driver provides probe, configure, trigger, read and powerdown and
+ * is listed in the static registry in sensor.c. A sample triggers all
+ * present sensors back to back, waits once for the longest conversion and
+ * reads all results in a burst, so the sensors convert in parallel.
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#ifndef _SENSOR_H_
+#define _SENSOR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SENSOR_MAX       4  /**< registry size */
+#define SENSOR_DATA_MAX  4  /**< result bytes per sensor */
+
+/** driver of one sensor, kept in program memory */
+typedef struct {
+    const char *name;                /**< name in program memory */
+    bool     (*probe)(void);         /**< true if the device answers */
+    bool     (*configure)(void);     /**< set up the device after a successful probe */
+    uint16_t (*trigger)(void);       /**< start a one-shot conversion, returns its duration in ms */
+    uint8_t  (*read)(uint8_t *buf);  /**< fetch the result, returns the bytes written, 0 on error */
+    void     (*powerdown)(void);     /**< put the device into its lowest power state */
+} sensor_driver_t;
+
+/** result of the last sample of one sensor */
+typedef struct {
+    uint8_t  len;                    /**< valid bytes in data, 0 if the read failed */
+    uint8_t  data[SENSOR_DATA_MAX];  /**< result as returned by the driver */
+    uint16_t bus_us;                 /**< bus time of trigger and read */
+    uint32_t latency_us;             /**< start of the trigger until the result was read */
+} sensor_reading_t;
+
+
+/**
+ * @brief sensor_probe_all
+ *
+ * @desc probe every registered driver and configure the sensors found
+ * @note i2c_init has to be called first
+ *
+ * @return number of sensors present
+ */
+uint8_t sensor_probe_all(void);
+
+
+/**
+ * @brief sensor_present
+ *
+ * @desc check if the sensor of registry slot idx was found by sensor_probe_all
+ */
+bool sensor_present(uint8_t idx);
+
+
+/**
+ * @brief sensor_name
+ *
+ * @desc return the name of registry slot idx in program memory, NULL if empty
+ */
+const char *sensor_name(uint8_t idx);
+
+
+/**
+ * @brief sensor_sample_all
+ *
+ * @desc trigger all present sensors, wait for the longest conversion and
+ *       read the results
+ * @note uses timer1, conversions have to finish within 350ms
+ *
+ * @return number of sensors read successfully
+ */
+uint8_t sensor_sample_all(void);
+
+
+/**
+ * @brief sensor_get
+ *
+ * @desc return the reading of registry slot idx from the last sample
+ */
+const sensor_reading_t *sensor_get(uint8_t idx);
+
+
+/**
+ * @brief sensor_powerdown_all
+ *
+ * @desc put all present sensors into their lowest power state
+ */
+void sensor_powerdown_all(void);
+
+#endif
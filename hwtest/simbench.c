@@ -0,0 +1,61 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file simbench.c
+ * Kernel benchmark for the simavr simulator
+ *
+ * Runs the kernels of benchmark.c on the simulated ATmega328P, timer1 is
+ * emulated cycle exact. The SPI of simavr shifts with the real clock
+ * divider and reads back the 0xff sent, which the flash driver takes for
+ * a ready device with erased pages: the log recovers as empty. The RTC
+ * is served by simtwi.c. simavr prints the UART output and quits when the
+ * cpu sleeps with interrupts disabled. See "make simbench".
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include "benchmark.h"
+#include "logstore.h"
+#include "spi_master.h"
+
+static int uart_putchar(char c, FILE *stream);
+static FILE simstdout = FDEV_SETUP_STREAM(uart_putchar, NULL, _FDEV_SETUP_WRITE);
+
+
+static int uart_putchar(char c, FILE *stream)
+{
+    loop_until_bit_is_set(UCSR0A, UDRE0);
+    UDR0 = c;
+    return 0;
+}
+
+
+int main(void)
+{
+    UBRR0H = 0;
+    UBRR0L = 0xb;
+    UCSR0A |= (1<<U2X0);
+    UCSR0C = (0<<USBS0) | (3<<UCSZ00);
+    UCSR0B |= (1<<TXEN0);
+    stdout = &simstdout;
+
+    DDRB |= 0x07;    // flash control signals, SS has to be an output
+    spi_masterInit();
+    log_recover(NULL);
+    bench_run_kernels();
+
+    /* let the last byte leave the UART, then end the simulation */
+    loop_until_bit_is_set(UCSR0A, TXC0);
+    cli();
+    sleep_enable();
+    sleep_cpu();
+    return 0;
+}
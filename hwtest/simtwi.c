@@ -0,0 +1,96 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file simtwi.c
+ * I2C master stand-in for the simavr benchmark
+ *
+ * simavr has no RV-8523 on its TWI, every start would end with a NACK and
+ * the RTC kernels would measure their error path only. This implementation
+ * of i2cmaster.h replaces twimaster.c in simbench.elf and serves the
+ * register file of an RV-8523, so the register accesses and the BCD
+ * decoding of rv8523.c run in full. The bus time is not included, it is
+ * measured on the target by hwtest testcase 14.
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <i2cmaster.h>
+
+#include "rv8523_regs.h"
+
+#define NUM_REGS (RV8523_TIMER_B+1)
+
+/* 2021-02-28 23:59:59, alarms and timers off */
+static uint8_t regs[NUM_REGS] = {
+    0x00, 0x00, 0x00,                          /* control 1..3 */
+    0x59, 0x59, 0x23, 0x28, 0x00, 0x02, 0x21,  /* time and date in bcd */
+    0x80, 0x80, 0x80, 0x80,                    /* alarms disabled */
+    0x00, 0x38, 0x00, 0x00, 0x00, 0x00         /* offset, timers */
+};
+static uint8_t regno;
+static bool selected;
+static bool addressed;    /**< the register number has been written */
+
+
+void i2c_init(void)
+{
+}
+
+
+void i2c_stop(void)
+{
+    selected = false;
+}
+
+
+unsigned char i2c_start(unsigned char addr)
+{
+    selected = ((addr & ~I2C_READ) == DEV_RV8523);
+    addressed = false;
+    return !selected;
+}
+
+
+unsigned char i2c_rep_start(unsigned char addr)
+{
+    return i2c_start(addr);
+}
+
+
+void i2c_start_wait(unsigned char addr)
+{
+    i2c_start(addr);
+}
+
+
+unsigned char i2c_write(unsigned char data)
+{
+    if(!selected)
+        return 1;
+    if(!addressed){
+        regno = data % NUM_REGS;
+        addressed = true;
+    }else{
+        regs[regno] = data;
+        regno = (regno+1) % NUM_REGS;
+    }
+    return 0;
+}
+
+
+unsigned char i2c_readAck(void)
+{
+    uint8_t val = regs[regno];
+    regno = (regno+1) % NUM_REGS;
+    return val;
+}
+
+
+unsigned char i2c_readNak(void)
+{
+    return i2c_readAck();
+}
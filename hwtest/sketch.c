@@ -0,0 +1,102 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file sketch.c
+ * Streaming quantile sketch with fixed memory
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sketch.h"
+#include "warmboot.h"
+
+#define EXACT_LIMIT (2UL << SKETCH_SUB_BITS)  /**< values below have a bin each */
+
+static uint16_t bins[SKETCH_BINS] NOINIT;
+static uint32_t total NOINIT;
+
+
+/*
+ * local functions
+ */
+
+/* normalise to [EXACT_LIMIT/2, EXACT_LIMIT), the shifts select the octave */
+static uint8_t bin_of(uint32_t v)
+{
+    uint8_t shift = 0;
+
+    if(v < EXACT_LIMIT)
+        return v;
+    while(v >= (EXACT_LIMIT << 8)){
+        v >>= 8;
+        shift += 8;
+    }
+    while(v >= EXACT_LIMIT){
+        v >>= 1;
+        ++shift;
+    }
+    return (shift << SKETCH_SUB_BITS) + v;
+}
+
+/* smallest value of a bin and log2 of its width */
+static uint32_t bin_low(uint8_t i, uint8_t *shift)
+{
+    *shift = i >> SKETCH_SUB_BITS;
+    if(*shift < 2){
+        *shift = 0;
+        return i;
+    }
+    --*shift;
+    return (uint32_t)(i - (*shift << SKETCH_SUB_BITS)) << *shift;
+}
+
+
+/*
+ * global functions
+ */
+
+void sketch_reset(void)
+{
+    memset(bins, 0, sizeof(bins));
+    total = 0;
+}
+
+
+void sketch_add(uint32_t value, uint16_t weight)
+{
+    uint16_t *b = &bins[bin_of(value)];
+
+    *b = (*b > 0xffff - weight) ? 0xffff : *b + weight;
+    total += weight;
+}
+
+
+uint32_t sketch_total(void)
+{
+    return total;
+}
+
+
+uint32_t sketch_quantile(uint8_t percent)
+{
+    uint32_t rank = total * percent / 100;
+    uint32_t cum = 0, low;
+    uint8_t i, shift;
+
+    if(total == 0)
+        return 0;
+    if(rank >= total)
+        rank = total-1;
+    for(i=0; i<SKETCH_BINS-1; ++i){
+        cum += bins[i];
+        if(cum > rank)
+            break;
+    }
+    low = bin_low(i, &shift);
+    return shift ? low + (1UL << (shift-1)) : low;
+}
@@ -0,0 +1,68 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file sketch.h
+ * Streaming quantile sketch with fixed memory
+ *
+ * The values are counted in a histogram with logarithmic bins: every
+ * octave is split into 2^SKETCH_SUB_BITS bins, values below
+ * 2^(SKETCH_SUB_BITS+1) get a bin each. A quantile is estimated with a
+ * relative error of at most 2^-(SKETCH_SUB_BITS+1), independent of the
+ * number of values. Adding a value takes a bounded number of cycles.
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#ifndef _SKETCH_H_
+#define _SKETCH_H_
+
+#include <stdint.h>
+
+#ifndef SKETCH_SUB_BITS
+#define SKETCH_SUB_BITS 2  /**< 4 bins per octave, 12.5% relative error */
+#endif
+
+/** bins covering the whole uint32_t range, 2 bytes each */
+#define SKETCH_BINS ((33 - SKETCH_SUB_BITS) << SKETCH_SUB_BITS)
+
+
+/**
+ * @brief sketch_reset
+ *
+ * @desc forget all values
+ */
+void sketch_reset(void);
+
+
+/**
+ * @brief sketch_add
+ *
+ * @desc count a value, a bin saturates at 65535
+ *
+ * @param value   value to add
+ * @param weight  how often the value counts, e.g. the minutes it stands for
+ */
+void sketch_add(uint32_t value, uint16_t weight);
+
+
+/**
+ * @brief sketch_total
+ *
+ * @desc return the sum of the weights added since the reset
+ */
+uint32_t sketch_total(void);
+
+
+/**
+ * @brief sketch_quantile
+ *
+ * @desc estimate a quantile from the histogram
+ *
+ * @param percent  0..100, e.g. 50 for the median
+ * @return the center of the bin holding the quantile, 0 if empty
+ */
+uint32_t sketch_quantile(uint8_t percent);
+
+#endif
@@ -0,0 +1,207 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file sketchtest.c
+ * Host test of the quantile sketch with recorded samples
+ *
+ * Reads logdump transfers of LOG_RAW (N or R command, P and : lines) and
+ * feeds the samples of each day to sketch.c the way summary_add does,
+ * weighted with the minutes until the next sample. The estimated
+ * quantiles are compared with the exact quantiles of the same samples:
+ * the sketch has to return the center of the bin holding the exact
+ * value. The bins are computed independently of sketch.c, so a wrong bin
+ * mapping fails even if it stays within the error bound.
+ *
+ *   sketchtest dump1.txt [dump2.txt ...]
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "record.h"
+#include "sketch.h"
+
+#define PAGE_MAX 1056   /**< largest page of the AT45DB family */
+
+/** one recorded sample and the minutes it stands for */
+typedef struct {
+    uint32_t ts;
+    uint32_t value;
+    uint16_t weight;
+} sample_t;
+
+static sample_t *samples;
+static size_t nsamples, maxsamples;
+
+
+/*
+ * local functions
+ */
+
+static void add_sample(uint32_t ts, uint32_t value)
+{
+    if(nsamples == maxsamples){
+        maxsamples = maxsamples ? 2*maxsamples : 4096;
+        samples = realloc(samples, maxsamples * sizeof(*samples));
+        if(!samples){
+            fprintf(stderr, "out of memory\n");
+            exit(2);
+        }
+    }
+    samples[nsamples].ts = ts;
+    samples[nsamples].value = value;
+    ++nsamples;
+}
+
+/* collect the SAMPLE records of the pages of one transfer */
+static void read_dump(FILE *f)
+{
+    static uint8_t page[PAGE_MAX];
+    char line[256];
+    unsigned pageno, nrec, nbytes = 0, schema = 0, byte, pos, i = 0;
+    unsigned long seq, tbase;
+    char *p;
+
+    while(fgets(line, sizeof(line), f)){
+        if(line[0] == 'P'){
+            if(sscanf(line, "P %u %lu %lu %u %u %u", &pageno, &seq, &tbase, &nrec, &nbytes, &schema) != 6)
+                nbytes = 0;   // no schema, nothing to test
+            if(nbytes > PAGE_MAX)
+                nbytes = PAGE_MAX;
+            i = 0;
+        }else if(line[0] == ':'){
+            for(p=line+1; i<nbytes && sscanf(p, "%2x", &byte) == 1; p+=2)
+                page[i++] = byte;
+            if(i < nbytes || schema != SCHEMA_ID)
+                continue;
+            for(pos=0; pos+1<nbytes && page[pos] && pos+1+page[pos]<=nbytes; pos+=1+page[pos])
+                if(page[pos+1] == REC_SAMPLE)
+                    add_sample(rec_sample_ts(&page[pos+1]), rec_sample_value(&page[pos+1]));
+        }
+    }
+}
+
+static int by_ts(const void *a, const void *b)
+{
+    const sample_t *x = a, *y = b;
+    return (x->ts > y->ts) - (x->ts < y->ts);
+}
+
+static int by_value(const void *a, const void *b)
+{
+    const sample_t *x = a, *y = b;
+    return (x->value > y->value) - (x->value < y->value);
+}
+
+/* center of the bin holding v, 2^SKETCH_SUB_BITS bins per octave */
+static uint32_t bin_center(uint32_t v)
+{
+    uint32_t width;
+    int msb;
+
+    if(v < (2UL << SKETCH_SUB_BITS))
+        return v;
+    for(msb=31; !(v >> msb); --msb)
+        ;
+    width = 1UL << (msb - SKETCH_SUB_BITS);
+    return (v & ~(width-1)) + width/2;
+}
+
+/* exact quantile with the rank definition of sketch_quantile */
+static uint32_t exact_quantile(const sample_t *s, size_t n, uint32_t total, uint8_t percent)
+{
+    uint32_t rank = total * percent / 100;
+    uint32_t cum = 0;
+    size_t i;
+
+    if(rank >= total)
+        rank = total-1;
+    for(i=0; i<n-1; ++i){
+        cum += s[i].weight;
+        if(cum > rank)
+            break;
+    }
+    return s[i].value;
+}
+
+/* compare sketch and exact quantiles of the samples of one day */
+static unsigned test_day(sample_t *s, size_t n)
+{
+    uint32_t total = 0, exact, est;
+    unsigned failed = 0;
+    uint8_t percent;
+    size_t i;
+
+    sketch_reset();
+    for(i=0; i<n; ++i){
+        sketch_add(s[i].value, s[i].weight);
+        total += s[i].weight;
+    }
+    qsort(s, n, sizeof(*s), by_value);
+
+    printf("day %5lu: %5zu samples %4lu minutes", (unsigned long)(s[0].ts / 86400UL), n, (unsigned long)total);
+    for(percent=5; percent<100; percent+=5){
+        exact = exact_quantile(s, n, total, percent);
+        est = sketch_quantile(percent);
+        if(est != bin_center(exact)){
+            printf("\n  p%-2u exact %lu sketch %lu, expected bin center %lu FAIL",
+                   percent, (unsigned long)exact, (unsigned long)est, (unsigned long)bin_center(exact));
+            ++failed;
+        }
+    }
+    printf(failed ? "\n" : " ok\n");
+    return failed;
+}
+
+
+/*
+ * global functions
+ */
+
+int main(int argc, char **argv)
+{
+    unsigned failed = 0, days = 0;
+    size_t first, i;
+    uint32_t gap;
+    FILE *f;
+    int a;
+
+    if(argc < 2){
+        fprintf(stderr, "usage: %s dump.txt [dump.txt ...]\n", argv[0]);
+        return 2;
+    }
+    for(a=1; a<argc; ++a){
+        if(!(f = fopen(argv[a], "r"))){
+            perror(argv[a]);
+            return 2;
+        }
+        read_dump(f);
+        fclose(f);
+    }
+    if(nsamples == 0){
+        fprintf(stderr, "no samples of schema %u found\n", SCHEMA_ID);
+        return 2;
+    }
+
+    /* the weight as in summary_add: minutes until the next sample */
+    qsort(samples, nsamples, sizeof(*samples), by_ts);
+    for(i=0; i<nsamples; ++i){
+        gap = (i+1 < nsamples) ? samples[i+1].ts - samples[i].ts : 60;
+        samples[i].weight = (gap >= 60) ? ((gap > 86400UL ? 86400UL : gap) + 30) / 60 : 1;
+    }
+
+    for(first=0, i=1; i<=nsamples; ++i){
+        if(i < nsamples && samples[i].ts / 86400UL == samples[first].ts / 86400UL)
+            continue;
+        failed += test_day(&samples[first], i - first);
+        ++days;
+        first = i;
+    }
+    printf("%u days, %u quantiles failed\n", days, failed);
+    return failed ? 1 : 0;
+}
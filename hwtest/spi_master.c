@@ -11,6 +11,7 @@
  */
 
 #include <avr/io.h>
+#include <util/atomic.h>
 
 #include "spi_master.h"
 
@@ -20,13 +21,74 @@
 #define DD_MISO  PB4
 #define DD_SCK   PB5
 
+static uint32_t sys_freq = F_CPU;
+static const spi_device_t *current = 0;  /**< device SPCR/SPSR are set up for */
+static const spi_device_t * volatile owner = 0;  /**< device holding the bus */
+
+
+/*
+ * local functions
+ */
+
+/* smallest divider keeping the SPI clock at or below max_hz */
+static uint8_t calc_div(uint32_t max_hz)
+{
+    uint8_t div = 2;
+    while(div < 128 && sys_freq/div > max_hz)
+        div <<= 1;
+    return div;
+}
+
+
+/*
+ * global functions
+ */
 
 void spi_masterInit(void)
 {
     /* Set MOSI and SCK output */
-    DDR_SPI = _BV(DD_MOSI) | _BV(DD_SCK);
+    DDR_SPI |= _BV(DD_MOSI) | _BV(DD_SCK);
     /* enable SPI, master, set clock rate fck/16 */
     SPCR = _BV(SPE) | _BV(MSTR) | _BV(SPR0);
+    current = 0;
+}
+
+void spi_masterInitDevice(const spi_device_t *dev)
+{
+    *dev->port |= dev->cs;
+    *(dev->port - 1) |= dev->cs;  // DDRx is located right below PORTx
+}
+
+bool spi_masterBegin(const spi_device_t *dev)
+{
+    bool free;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        free = (owner == 0);
+        if(free)
+            owner = dev;
+    }
+    if(!free)
+        return false;
+
+    if(dev != current){
+        SPCR = _BV(SPE) | _BV(MSTR) | dev->mode;
+        spi_masterSetClockDiv(calc_div(dev->max_hz));
+        current = dev;
+    }
+    *dev->port &= ~dev->cs;
+    return true;
+}
+
+void spi_masterEnd(const spi_device_t *dev)
+{
+    *dev->port |= dev->cs;
+    owner = 0;
+}
+
+bool spi_masterBusy(void)
+{
+    return owner != 0;
 }
 
 uint8_t spi_masterTransmit(uint8_t data)
@@ -39,3 +101,30 @@ uint8_t spi_masterTransmit(uint8_t data)
     
     return SPDR;
 }
+
+void spi_masterSetSysClock(uint32_t freq)
+{
+    sys_freq = freq;
+    current = 0;
+}
+
+void spi_masterSetClockDiv(uint8_t div)
+{
+    /* SPR1:0 select fck/4,16,64,128, SPI2X doubles the first three */
+    uint8_t k = 0;
+
+    for(; div > 1; div >>= 1)
+        ++k;                      // k = log2(div)
+    if(k == 0)
+        k = 1;                    // fck/2 is the fastest setting
+    if(k >= 7){
+        SPCR |= _BV(SPR1) | _BV(SPR0);
+        SPSR &= ~_BV(SPI2X);
+        return;
+    }
+    SPCR = (SPCR & ~(_BV(SPR1) | _BV(SPR0))) | ((k-1) >> 1);
+    if(k & 0x01)
+        SPSR |= _BV(SPI2X);
+    else
+        SPSR &= ~_BV(SPI2X);
+}
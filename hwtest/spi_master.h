@@ -4,6 +4,13 @@
  * Access routines SPI in master mode
  * tested with Atmega 328P
  *
+ * Several devices share the bus, each described by an spi_device_t with
+ * its chip select, SPI mode and maximum clock. A transaction starts with
+ * spi_masterBegin and ends with spi_masterEnd, any number of
+ * spi_masterTransmit calls in between go out under one chip select.
+ * SPCR/SPSR are only rewritten if the device differs from the one used
+ * last, so back-to-back transactions to the flash cost no setup.
+ *
  * Version 0.1
  *
  * Copyright 2021 - Michael Staudenmaier
@@ -13,8 +20,101 @@
 #ifndef _SPI_MASTER_H_
 #define _SPI_MASTER_H_
 
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/io.h>
+
+/* SPCR bits of the modes, SPI_LSB_FIRST may be or'ed in */
+#define SPI_MODE0      0
+#define SPI_MODE1      _BV(CPHA)
+#define SPI_MODE2      _BV(CPOL)
+#define SPI_MODE3      (_BV(CPOL) | _BV(CPHA))
+#define SPI_LSB_FIRST  _BV(DORD)
+
+/** one device on the bus, usually a const in the driver */
+typedef struct {
+    volatile uint8_t *port;  /**< PORTx of the chip select, active low */
+    uint8_t  cs;             /**< bit mask of the chip select pin */
+    uint8_t  mode;           /**< SPI_MODE0..3, optionally | SPI_LSB_FIRST */
+    uint32_t max_hz;         /**< fastest SPI clock the device accepts */
+} spi_device_t;
+
+
+/**
+ * @brief spi_masterInit
+ *
+ * @desc enable the SPI in master mode, MOSI and SCK become outputs.
+ *       Other pins of port B are left alone.
+ * @note SS (PB2) has to be an output, else a low level on it switches the
+ *       SPI to slave mode. It is the flash chip select on this board.
+ */
 void spi_masterInit(void);
 
+
+/**
+ * @brief spi_masterInitDevice
+ *
+ * @desc make the chip select of a device an output driving high
+ *
+ * @param *dev  the device
+ */
+void spi_masterInitDevice(const spi_device_t *dev);
+
+
+/**
+ * @brief spi_masterBegin
+ *
+ * @desc claim the bus for a device and pull its chip select low. The SPI
+ *       is reconfigured only if another device was used before.
+ *       May be called from an ISR, it fails then if the main program is
+ *       in the middle of a transaction.
+ *
+ * @param *dev  the device
+ * @return false if another device holds the bus
+ */
+bool spi_masterBegin(const spi_device_t *dev);
+
+
+/**
+ * @brief spi_masterEnd
+ *
+ * @desc release the chip select and the bus
+ *
+ * @param *dev  the device passed to spi_masterBegin
+ */
+void spi_masterEnd(const spi_device_t *dev);
+
+
+/**
+ * @brief spi_masterBusy
+ *
+ * @desc tell if a device holds the bus, spi_masterBegin fails meanwhile
+ */
+bool spi_masterBusy(void);
+
+
 uint8_t spi_masterTransmit(uint8_t data);
 
+
+/**
+ * @brief spi_masterSetSysClock
+ *
+ * @desc tell the bus the current system clock, the dividers of all devices
+ *       are recalculated with their next transaction
+ *
+ * @param freq  system clock in Hz
+ */
+void spi_masterSetSysClock(uint32_t freq);
+
+
+/**
+ * @brief spi_masterSetClockDiv
+ *
+ * @desc set the SPI clock to system clock / div, overriding max_hz of the
+ *       active device until another device is used
+ *
+ * @param div  2, 4, 8, 16, 32, 64 or 128
+ */
+void spi_masterSetClockDiv(uint8_t div);
+
 #endif
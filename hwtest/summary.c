@@ -0,0 +1,117 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file summary.c
+ * Hour and day summaries of the sampled values
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+#include "logstore.h"
+#include "sketch.h"
+#include "summary.h"
+#include "warmboot.h"
+
+/** accumulator of the running period of one tier */
+typedef struct {
+    uint32_t period;  /**< ts / length of the tier */
+    uint32_t min;
+    uint32_t max;
+    uint64_t wsum;    /**< sum of value * weight */
+    uint32_t weight;  /**< sum of the weights */
+    uint16_t count;   /**< samples, 0 if the period is not started */
+} summary_tier_t;
+
+/** tiers from short to long, length in seconds and record type */
+static const struct {
+    uint32_t length;
+    uint8_t  type;
+} tiers[] PROGMEM = {
+    {3600UL,  SUMMARY_REC_HOUR},
+    {86400UL, SUMMARY_REC_DAY},
+};
+
+#define NUM_TIERS (sizeof(tiers)/sizeof(tiers[0]))
+
+static summary_tier_t acc[NUM_TIERS] NOINIT;
+
+
+/*
+ * local functions
+ */
+
+static void emit(uint8_t i)
+{
+    rec_summary_t rec;
+    uint8_t buf[REC_SIZE(summary)];
+    uint32_t length = pgm_read_dword(&tiers[i].length);
+
+    rec.type = pgm_read_byte(&tiers[i].type);
+    rec.start = acc[i].period * length;
+    rec.min = acc[i].min;
+    rec.max = acc[i].max;
+    rec.mean = acc[i].weight ? acc[i].wsum / acc[i].weight : 0;
+    rec.count = acc[i].count;
+    log_append(LOG_SUMMARY, rec.start, buf, rec_pack_summary(&rec, buf));
+}
+
+static void emit_quantiles(uint32_t start)
+{
+    rec_quant_t rec;
+    uint8_t buf[REC_SIZE(quant)];
+
+    rec.type = SUMMARY_REC_QUANT;
+    rec.start = start;
+    rec.minutes = sketch_total();
+    rec.p5 = sketch_quantile(5);
+    rec.p50 = sketch_quantile(50);
+    rec.p95 = sketch_quantile(95);
+    log_append(LOG_SUMMARY, start, buf, rec_pack_quant(&rec, buf));
+    sketch_reset();
+}
+
+
+/*
+ * global functions
+ */
+
+void summary_add(uint32_t ts, uint32_t value, uint16_t weight)
+{
+    uint32_t period;
+    uint8_t i;
+
+    for(i=0; i<NUM_TIERS; ++i){
+        summary_tier_t *t = &acc[i];
+
+        period = ts / pgm_read_dword(&tiers[i].length);
+        if(t->count && period != t->period){
+            emit(i);
+            /* a page per day, the longest tier makes it durable */
+            if(i == NUM_TIERS-1){
+                emit_quantiles(t->period * pgm_read_dword(&tiers[i].length));
+                log_commit(LOG_SUMMARY);
+            }
+            t->count = 0;
+        }
+        if(t->count == 0){
+            t->period = period;
+            t->min = value;
+            t->max = value;
+            t->wsum = 0;
+            t->weight = 0;
+        }
+        if(value < t->min)
+            t->min = value;
+        if(value > t->max)
+            t->max = value;
+        t->wsum += (uint64_t)value * weight;
+        t->weight += weight;
+        ++t->count;
+    }
+    sketch_add(value, (weight >= 60) ? (weight + 30) / 60 : 1);
+}
@@ -0,0 +1,43 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file summary.h
+ * Hour and day summaries of the sampled values
+ *
+ * Every sample updates min, max, time weighted mean and count of the
+ * current hour and day. When a sample falls into the next period the
+ * summary of the finished one is appended to the LOG_SUMMARY stream,
+ * which is committed once per day. The RAM needed per tier is constant.
+ * The day summary is followed by the p5, p50 and p95 quantiles of the
+ * day, estimated with the histogram sketch.
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#ifndef _SUMMARY_H_
+#define _SUMMARY_H_
+
+#include <stdint.h>
+
+#include "record.h"
+
+/* log record types, the layouts rec_summary_t and rec_quant_t are in schema.h */
+#define SUMMARY_REC_HOUR  REC_HOUR    /**< record type of an hour summary */
+#define SUMMARY_REC_DAY   REC_DAYSUM  /**< record type of a day summary */
+#define SUMMARY_REC_QUANT REC_QUANT   /**< p5, p50, p95 of a day with 12.5% relative error */
+
+
+/**
+ * @brief summary_add
+ *
+ * @desc add a sample to all tiers, finished periods are logged first
+ *
+ * @param ts      timestamp of the sample, see rv8523_getTimestamp
+ * @param value   sample value
+ * @param weight  seconds the sample stands for, i.e. the sampling interval
+ */
+void summary_add(uint32_t ts, uint32_t value, uint16_t weight);
+
+#endif
@@ -0,0 +1,84 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file warmboot.c
+ * Logger state surviving watchdog and brown-out resets
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#include <string.h>
+#include <avr/io.h>
+#include <avr/wdt.h>
+#include <util/crc16.h>
+
+#include "warmboot.h"
+
+/* provided by the avr-libc linker scripts */
+extern uint8_t __noinit_start;
+extern uint8_t __noinit_end;
+
+/** bookkeeping, lives in .noinit as well but is left out of the crc */
+static struct {
+    uint16_t crc;
+    uint8_t  mcusr;
+} warm NOINIT;
+
+void warm_early(void) __attribute__((naked, used, section(".init3")));
+
+
+/*
+ * local functions
+ */
+
+/* crc over .noinit without the bookkeeping */
+static uint16_t state_crc(void)
+{
+    const uint8_t *p;
+    uint16_t crc = 0xffff;
+
+    for(p=&__noinit_start; p<&__noinit_end; ++p)
+        if(p < (const uint8_t *)&warm || p >= (const uint8_t *)(&warm + 1))
+            crc = _crc_ccitt_update(crc, *p);
+    return crc;
+}
+
+
+/*
+ * global functions
+ */
+
+/* runs before main: the watchdog stays enabled after a watchdog reset
+   and has to be stopped within its shortest period */
+void warm_early(void)
+{
+    warm.mcusr = MCUSR;
+    MCUSR = 0;
+    wdt_disable();
+}
+
+
+bool warm_boot(void)
+{
+    uint8_t mcusr = warm.mcusr;
+
+    if((mcusr & (_BV(WDRF) | _BV(BORF))) && !(mcusr & _BV(PORF)) && state_crc() == warm.crc)
+        return true;
+    memset(&__noinit_start, 0, &__noinit_end - &__noinit_start);
+    warm.mcusr = mcusr;
+    return false;
+}
+
+
+uint8_t warm_reset_flags(void)
+{
+    return warm.mcusr;
+}
+
+
+void warm_seal(void)
+{
+    warm.crc = state_crc();
+}
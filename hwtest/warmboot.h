@@ -0,0 +1,59 @@
+/**
+ * -------------------------------------------------------------------------
+ * @file warmboot.h
+ * Logger state surviving watchdog and brown-out resets
+ *
+ * The state of logstore, sampler, summary and sketch is placed in the
+ * .noinit section, which the startup code doesn't clear. warm_seal
+ * protects the section with a crc. After a watchdog or brown-out reset
+ * warm_boot finds the crc intact and the firmware resumes without
+ * rescanning the flash or initializing the RTC. On any other reset, or
+ * with a broken crc, the section is cleared, which gives the state a cold
+ * boot always had.
+ *
+ * Version 0.1
+ *
+ * Copyright 2021 - Michael Staudenmaier
+ * -------------------------------------------------------------------------
+ */
+
+#ifndef _WARMBOOT_H_
+#define _WARMBOOT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* place a static variable in the warm boot state, without initializer */
+#define NOINIT __attribute__((section(".noinit")))
+
+
+/**
+ * @brief warm_boot
+ *
+ * @desc decide between warm and cold boot, call it first in main.
+ *       A cold boot clears the .noinit section.
+ *
+ * @return true if the state in .noinit is valid
+ */
+bool warm_boot(void);
+
+
+/**
+ * @brief warm_reset_flags
+ *
+ * @desc return MCUSR of the last reset, it is cleared during startup
+ */
+uint8_t warm_reset_flags(void);
+
+
+/**
+ * @brief warm_seal
+ *
+ * @desc update the crc over the .noinit section. Call it when the state is
+ *       consistent, e.g. at the end of each wake cycle. A reset between a
+ *       state change and the next seal leads to a cold boot.
+ * @note some 400 bytes are covered, this needs about 1ms
+ */
+void warm_seal(void);
+
+#endif